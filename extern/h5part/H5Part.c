@@ -135,9 +135,11 @@ _H5Part_open_file (
     const char flags,	/*!< [in] The access mode for the file. */
     MPI_Comm comm,		/*!< [in] MPI communicator */
     int f_parallel,		/*!< [in] 0 for serial io otherwise parallel */
-    h5part_int64_t align	/*!< [in] Number of bytes for setting alignment,
+    h5part_int64_t align,	/*!< [in] Number of bytes for setting alignment,
                       metadata block size, etc.
                       Set to 0 to disable. */
+    const void *mpi_info	/*!< [in] Pointer to an MPI_Info with MPI-IO hints
+                      for parallel io, or NULL for none. */
 ) {
 
     _h5part_errno = H5PART_SUCCESS;
@@ -166,7 +168,7 @@ _H5Part_open_file (
 
     if ( f_parallel ) {
 #ifdef H5PART_PARALLEL_IO
-        MPI_Info info = MPI_INFO_NULL;
+        MPI_Info info = mpi_info ? *(const MPI_Info*)mpi_info : MPI_INFO_NULL;
 
         if (MPI_Comm_size (comm, &f->nprocs) != MPI_SUCCESS) {
             HANDLE_MPI_COMM_SIZE_ERR;
@@ -396,7 +398,7 @@ H5PartOpenFileParallel (
     int f_parallel = 1;	/* parallel i/o */
     h5part_int64_t align = 0; /* no alignment tuning */
 
-    return _H5Part_open_file ( filename, flags, comm, f_parallel, align );
+    return _H5Part_open_file ( filename, flags, comm, f_parallel, align, NULL );
 }
 
 /*!
@@ -419,7 +421,32 @@ H5PartOpenFileParallelAlign (
 
     int f_parallel = 1;	/* parallel i/o */
 
-    return _H5Part_open_file ( filename, flags, comm, f_parallel, align );
+    return _H5Part_open_file ( filename, flags, comm, f_parallel, align, NULL );
+}
+
+/*!
+  \ingroup h5part_open
+
+  Opens file with specified filename, alignment value and MPI-IO hints,
+  e.g. collective buffering settings like \c cb_nodes. The hints are
+  passed to the MPI-IO file driver, \c info may be freed afterwards.
+
+  \return	File handle or \c NULL
+ */
+H5PartFile*
+H5PartOpenFileParallelHints (
+    const char *filename,	/*!< [in] The name of the data file to open. */
+    const char flags,	/*!< [in] The access mode for the file. */
+    MPI_Comm comm,		/*!< [in] MPI communicator */
+    h5part_int64_t align,	/*!< [in] Alignment size in bytes. */
+    MPI_Info info		/*!< [in] MPI-IO hints */
+) {
+    INIT
+    SET_FNAME ( "H5PartOpenFileParallelHints" );
+
+    int f_parallel = 1;	/* parallel i/o */
+
+    return _H5Part_open_file ( filename, flags, comm, f_parallel, align, &info );
 }
 #endif
 
@@ -455,7 +482,7 @@ H5PartOpenFile (
     int f_parallel = 0;	/* serial open */
     int align = 0;		/* no tuning parameters */
 
-    return _H5Part_open_file ( filename, flags, comm, f_parallel, align );
+    return _H5Part_open_file ( filename, flags, comm, f_parallel, align, NULL );
 }
 
 /*!
@@ -478,7 +505,7 @@ H5PartOpenFileAlign (
     MPI_Comm comm = 0;	/* dummy */
     int f_parallel = 0;	/* serial open */
 
-    return _H5Part_open_file ( filename, flags, comm, f_parallel, align );
+    return _H5Part_open_file ( filename, flags, comm, f_parallel, align, NULL );
 }
 
 /*!
@@ -94,6 +94,15 @@ H5PartOpenFileParallelAlign (
     MPI_Comm communicator,
     h5part_int64_t align
     );
+
+H5PartFile*
+H5PartOpenFileParallelHints (
+    const char *filename,
+    const char flags,
+    MPI_Comm communicator,
+    h5part_int64_t align,
+    MPI_Info info
+    );
 #endif
 
 
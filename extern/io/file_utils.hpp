@@ -1,6 +1,7 @@
 #pragma once
 
 #include <fstream>
+#include <tuple>
 #include <vector>
 #include <variant>
 
@@ -84,5 +85,24 @@ void readAscii(const std::string& path, size_t numLines, const std::vector<T*>&
     else { throw std::runtime_error("Can't open file at path: " + path); }
 }
 
+//! @brief the range [start:end) of rank @p i when distributing @p R elements evenly over @p N ranks
+inline auto partitionRange(size_t R, size_t i, size_t N)
+{
+    size_t s = R / N;
+    size_t r = R % N;
+    if (i < r)
+    {
+        size_t start = (s + 1) * i;
+        size_t end   = start + s + 1;
+        return std::make_tuple(start, end);
+    }
+    else
+    {
+        size_t start = (s + 1) * r + s * (i - r);
+        size_t end   = start + s;
+        return std::make_tuple(start, end);
+    }
+}
+
 } // namespace fileutils
 } // namespace sphexa
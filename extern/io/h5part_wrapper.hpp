@@ -30,6 +30,7 @@
 
 #pragma once
 
+#include <iostream>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -319,14 +320,18 @@ inline h5part_int64_t writeH5PartField(H5PartFile* h5_file, const std::string& f
     return H5PartWriteDataInt64(h5_file, fieldName.c_str(), (const h5part_int64_t*)field);
 }
 
-//! @brief Open in parallel mode if supported, otherwise serial if numRanks == 1
-H5PartFile* openH5Part(const std::string& path, h5part_int64_t mode, MPI_Comm comm)
+/*! @brief Open in parallel mode with optional MPI-IO hints if supported, otherwise serial if numRanks == 1
+ *
+ * A serial HDF5 build has no MPI-IO layer, the hints are then ignored with a warning.
+ */
+H5PartFile* openH5Part(const std::string& path, h5part_int64_t mode, MPI_Comm comm,
+                       [[maybe_unused]] MPI_Info hints = MPI_INFO_NULL)
 {
     const char* h5_fname = path.c_str();
     H5PartFile* h5_file  = nullptr;
 
 #ifdef H5PART_PARALLEL_IO
-    h5_file = H5PartOpenFileParallel(h5_fname, mode, comm);
+    h5_file = H5PartOpenFileParallelHints(h5_fname, mode, comm, 0, hints);
 #else
     int numRanks;
     MPI_Comm_size(comm, &numRanks);
@@ -334,6 +339,12 @@ H5PartFile* openH5Part(const std::string& path, h5part_int64_t mode, MPI_Comm co
     {
         throw std::runtime_error("Cannot open HDF5 file on multiple ranks without parallel HDF5 support\n");
     }
+    static bool hintsWarned = false;
+    if (hints != MPI_INFO_NULL && !hintsWarned)
+    {
+        std::cerr << "Warning: HDF5 is built without parallel IO, the MPI-IO hints are ignored" << std::endl;
+        hintsWarned = true;
+    }
     h5_file = H5PartOpenFile(h5_fname, mode);
 #endif
 
@@ -31,6 +31,7 @@
 #pragma once
 
 #include <map>
+#include <stdexcept>
 #include <string>
 #include <variant>
 #include <vector>
@@ -69,6 +70,12 @@ public:
     virtual void    fileAttribute(const std::string& key, FieldType val, int64_t size) = 0;
     virtual void    writeField(const std::string& key, FieldType field, int col)       = 0;
     virtual void    closeStep()                                                        = 0;
+
+    //! @brief write a C-order array of shape @p dims next to the fields of the current step, e.g. a 2D histogram
+    virtual void stepArray(const std::string& key, FieldType /*val*/, const std::vector<uint64_t>& /*dims*/)
+    {
+        throw std::runtime_error("File writer does not support step arrays: " + key + "\n");
+    }
 };
 
 enum class FileMode
@@ -94,6 +101,8 @@ public:
     virtual void                     fileAttribute(const std::string& key, FieldType val, int64_t size) = 0;
     virtual void                     stepAttribute(const std::string& key, FieldType val, int64_t size) = 0;
     virtual void                     readField(const std::string& key, FieldType field)                 = 0;
+    //! @brief restrict subsequent readField calls to local particles [first:last), relative to this rank's range
+    virtual void                     setLocalView(uint64_t first, uint64_t last)                        = 0;
     virtual uint64_t                 localNumParticles()                                                = 0;
     virtual uint64_t                 globalNumParticles()                                               = 0;
     virtual void                     closeStep()                                                        = 0;
@@ -128,6 +137,7 @@ public:
     void     fileAttribute(const std::string&, FieldType, int64_t) override { throwError(); }
     void     stepAttribute(const std::string&, FieldType, int64_t) override { throwError(); }
     void     readField(const std::string&, FieldType) override { throwError(); }
+    void     setLocalView(uint64_t, uint64_t) override { throwError(); }
     uint64_t localNumParticles() override
     {
         throwError();
@@ -30,11 +30,14 @@
 
 #include <mpi.h>
 
+#include <algorithm>
+#include <array>
 #include <filesystem>
 #include <string>
 #include <variant>
 #include <vector>
 
+#include "file_utils.hpp"
 #include "ifile_io_impl.h"
 
 #ifdef SPH_EXA_HAVE_H5PART
@@ -46,6 +49,18 @@ namespace sphexa
 
 #ifdef SPH_EXA_HAVE_H5PART
 
+template<class T>
+hid_t h5NativeType()
+{
+    if constexpr (std::is_same_v<T, double>) { return H5T_NATIVE_DOUBLE; }
+    else if constexpr (std::is_same_v<T, float>) { return H5T_NATIVE_FLOAT; }
+    else if constexpr (std::is_same_v<T, char>) { return H5T_NATIVE_CHAR; }
+    else if constexpr (std::is_same_v<T, int>) { return H5T_NATIVE_INT; }
+    else if constexpr (std::is_same_v<T, int64_t>) { return H5T_NATIVE_INT64; }
+    else if constexpr (std::is_same_v<T, unsigned>) { return H5T_NATIVE_UINT; }
+    else { return H5T_NATIVE_UINT64; }
+}
+
 class H5PartWriter final : public IFileWriter
 {
 public:
@@ -92,19 +107,53 @@ public:
 
     void stepAttribute(const std::string& key, FieldType val, int64_t size) override
     {
-        std::visit([this, &key, size](auto arg) { fileutils::writeH5PartStepAttrib(h5File_, key.c_str(), arg, size); },
-                   val);
+        checkStatus(
+            std::visit([this, &key, size](auto arg)
+                       { return fileutils::writeH5PartStepAttrib(h5File_, key.c_str(), arg, size); }, val),
+            "step attribute " + key);
     }
 
     void fileAttribute(const std::string& key, FieldType val, int64_t size) override
     {
-        std::visit([this, &key, size](auto arg) { fileutils::writeH5PartFileAttrib(h5File_, key.c_str(), arg, size); },
-                   val);
+        checkStatus(
+            std::visit([this, &key, size](auto arg)
+                       { return fileutils::writeH5PartFileAttrib(h5File_, key.c_str(), arg, size); }, val),
+            "file attribute " + key);
     }
 
     void writeField(const std::string& key, FieldType field, int = 0) override
     {
-        std::visit([this, &key](auto arg) { fileutils::writeH5PartField(h5File_, key, arg + firstIndex_); }, field);
+        checkStatus(std::visit([this, &key](auto arg)
+                               { return fileutils::writeH5PartField(h5File_, key, arg + firstIndex_); }, field),
+                    "field " + key);
+    }
+
+    /*! @brief write a C-order array into the group of the current step, creating intermediate groups in @p key
+     *
+     * Arrays with a '/' in @p key live in subgroups of the step, where they do not count as particle fields. Unlike
+     * step attributes, arrays are not limited to the 64 KB of an HDF5 object header.
+     */
+    void stepArray(const std::string& key, FieldType val, const std::vector<uint64_t>& dims) override
+    {
+        herr_t err = std::visit(
+            [this, &key, &dims](auto arg)
+            {
+                using T = std::remove_const_t<std::remove_pointer_t<decltype(arg)>>;
+                std::vector<hsize_t> shape(dims.begin(), dims.end());
+
+                hid_t lcpl = H5Pcreate(H5P_LINK_CREATE);
+                H5Pset_create_intermediate_group(lcpl, 1);
+                hid_t  space = H5Screate_simple(shape.size(), shape.data(), nullptr);
+                hid_t  dset  = H5Dcreate2(h5File_->timegroup, key.c_str(), h5NativeType<T>(), space, lcpl,
+                                          H5P_DEFAULT, H5P_DEFAULT);
+                herr_t err   = dset < 0 ? -1 : H5Dwrite(dset, h5NativeType<T>(), H5S_ALL, H5S_ALL, H5P_DEFAULT, arg);
+                if (dset >= 0) { H5Dclose(dset); }
+                H5Sclose(space);
+                H5Pclose(lcpl);
+                return err;
+            },
+            val);
+        checkStatus(err, "step array " + key);
     }
 
     void closeStep() override
@@ -117,6 +166,12 @@ public:
     }
 
 private:
+    //! @brief H5Part and HDF5 report failures with negative codes, e.g. for attributes beyond the header size limit
+    void checkStatus(int64_t status, const std::string& what) const
+    {
+        if (status < 0) { throw std::runtime_error("Could not write " + what + " to " + pathStep_ + "\n"); }
+    }
+
     int      rank_{0}, numRanks_{0};
     MPI_Comm comm_;
 
@@ -128,22 +183,185 @@ private:
 
 std::unique_ptr<IFileWriter> makeH5PartWriter(MPI_Comm comm) { return std::make_unique<H5PartWriter>(comm); }
 
-inline auto partitionRange(size_t R, size_t i, size_t N)
+/*! @brief writes a distributed 3D grid into root-level datasets of an HDF5 file, one hyperslab per rank
+ *
+ * Each rank owns the box [boxLow, boxLow + boxSize) of the global grid, stored with x fastest as in a heFFTe inbox.
+ * In the file, the datasets have the C-order shape (z, y, x). With parallel HDF5, all ranks write collectively.
+ * Otherwise they take turns on the file in rank order. Attributes go to the file root. addStep() replaces any
+ * existing file at the path.
+ */
+class H5GridWriter final : public IFileWriter
 {
-    size_t s = R / N;
-    size_t r = R % N;
-    if (i < r)
+public:
+    using Base      = IFileWriter;
+    using FieldType = typename Base::FieldType;
+
+    H5GridWriter(MPI_Comm comm, const std::array<uint64_t, 3>& globalSize, const std::array<uint64_t, 3>& boxLow,
+                 const std::array<uint64_t, 3>& boxSize)
+        : comm_(comm)
     {
-        size_t start = (s + 1) * i;
-        size_t end   = start + s + 1;
-        return std::make_tuple(start, end);
+        MPI_Comm_rank(comm, &rank_);
+        MPI_Comm_size(comm, &numRanks_);
+        for (int d = 0; d < 3; d++)
+        {
+            globalDims_[2 - d] = globalSize[d];
+            start_[2 - d]      = boxLow[d];
+            count_[2 - d]      = boxSize[d];
+        }
     }
-    else
+
+    ~H5GridWriter() override { closeStep(); }
+
+    [[nodiscard]] int rank() const override { return rank_; }
+    [[nodiscard]] int numRanks() const override { return numRanks_; }
+
+    std::string suffix() const override { return ".h5"; }
+
+    //! @brief [firstIndex:lastIndex) of the fields passed to writeField has to hold exactly the local box
+    void addStep(size_t firstIndex, size_t lastIndex, std::string path) override
+    {
+        closeStep();
+        if (lastIndex - firstIndex != count_[0] * count_[1] * count_[2])
+        {
+            throw std::runtime_error("Grid writer: local range does not match the local box\n");
+        }
+        firstIndex_ = firstIndex;
+        path_       = path;
+
+#ifdef H5PART_PARALLEL_IO
+        hid_t fapl = H5Pcreate(H5P_FILE_ACCESS);
+        H5Pset_fapl_mpio(fapl, comm_, MPI_INFO_NULL);
+        file_ = H5Fcreate(path_.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, fapl);
+        H5Pclose(fapl);
+        if (file_ < 0) { throw std::runtime_error("Could not create grid file " + path_); }
+#else
+        int err = 0;
+        if (rank_ == 0)
+        {
+            hid_t file = H5Fcreate(path_.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+            err        = file < 0;
+            if (!err) { H5Fclose(file); }
+        }
+        MPI_Bcast(&err, 1, MPI_INT, 0, comm_);
+        if (err) { throw std::runtime_error("Could not create grid file " + path_); }
+#endif
+    }
+
+    void stepAttribute(const std::string& key, FieldType val, int64_t size) override { fileAttribute(key, val, size); }
+
+    //! @brief all ranks pass the same value, rank 0 writes it unless the file is open in parallel
+    void fileAttribute(const std::string& key, FieldType val, int64_t size) override
     {
-        size_t start = (s + 1) * r + s * (i - r);
-        size_t end   = start + s;
-        return std::make_tuple(start, end);
+        std::visit(
+            [this, &key, size](auto arg)
+            {
+                using T = std::remove_const_t<std::remove_pointer_t<decltype(arg)>>;
+                inTurn(rank_ == 0,
+                       [&key, arg, size](hid_t file)
+                       {
+                           hsize_t n     = size;
+                           hid_t   space = H5Screate_simple(1, &n, nullptr);
+                           if (H5Aexists(file, key.c_str()) > 0) { H5Adelete(file, key.c_str()); }
+                           hid_t attr = H5Acreate2(file, key.c_str(), h5NativeType<T>(), space, H5P_DEFAULT, H5P_DEFAULT);
+                           herr_t err = H5Awrite(attr, h5NativeType<T>(), arg);
+                           H5Aclose(attr);
+                           H5Sclose(space);
+                           return err;
+                       });
+            },
+            val);
     }
+
+    void writeField(const std::string& key, FieldType field, int = 0) override
+    {
+        std::visit(
+            [this, &key](auto arg)
+            {
+                using T = std::remove_const_t<std::remove_pointer_t<decltype(arg)>>;
+                inTurn(true, [this, &key, data = arg + firstIndex_](hid_t file)
+                       { return writeSlab(file, key, h5NativeType<T>(), data); });
+            },
+            field);
+    }
+
+    void closeStep() override
+    {
+        if (file_ >= 0)
+        {
+            H5Fclose(file_);
+            file_ = -1;
+        }
+        path_.clear();
+    }
+
+private:
+    herr_t writeSlab(hid_t file, const std::string& key, hid_t memType, const void* data)
+    {
+        hid_t dset;
+        if (H5Lexists(file, key.c_str(), H5P_DEFAULT) > 0) { dset = H5Dopen2(file, key.c_str(), H5P_DEFAULT); }
+        else
+        {
+            hid_t fileSpace = H5Screate_simple(3, globalDims_.data(), nullptr);
+            dset = H5Dcreate2(file, key.c_str(), memType, fileSpace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+            H5Sclose(fileSpace);
+        }
+        if (dset < 0) { return -1; }
+
+        hid_t fileSpace = H5Dget_space(dset);
+        hid_t memSpace  = H5Screate_simple(3, count_.data(), nullptr);
+        H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, start_.data(), nullptr, count_.data(), nullptr);
+
+        hid_t xfer = H5Pcreate(H5P_DATASET_XFER);
+#ifdef H5PART_PARALLEL_IO
+        H5Pset_dxpl_mpio(xfer, H5FD_MPIO_COLLECTIVE);
+#endif
+        herr_t err = H5Dwrite(dset, memType, memSpace, fileSpace, xfer, data);
+
+        H5Pclose(xfer);
+        H5Sclose(memSpace);
+        H5Sclose(fileSpace);
+        H5Dclose(dset);
+        return err;
+    }
+
+    //! @brief run @p write on the file, collectively or with one rank at a time, and check it on all ranks
+    template<class F>
+    void inTurn(bool participate, F&& write)
+    {
+        if (path_.empty()) { throw std::runtime_error("Grid writer: no step added\n"); }
+        int err = 0;
+#ifdef H5PART_PARALLEL_IO
+        err = write(file_) < 0;
+#else
+        for (int r = 0; r < numRanks_; r++)
+        {
+            if (r == rank_ && participate)
+            {
+                hid_t file = H5Fopen(path_.c_str(), H5F_ACC_RDWR, H5P_DEFAULT);
+                err        = file < 0 || write(file) < 0;
+                if (file >= 0) { H5Fclose(file); }
+            }
+            MPI_Barrier(comm_);
+        }
+#endif
+        MPI_Allreduce(MPI_IN_PLACE, &err, 1, MPI_INT, MPI_MAX, comm_);
+        if (err) { throw std::runtime_error("Could not write to grid file " + path_); }
+    }
+
+    int      rank_{0}, numRanks_{0};
+    MPI_Comm comm_;
+
+    std::array<hsize_t, 3> globalDims_, start_, count_;
+    size_t                 firstIndex_{0};
+    std::string            path_;
+    hid_t                  file_{-1};
+};
+
+std::unique_ptr<IFileWriter> makeH5GridWriter(MPI_Comm comm, const std::array<uint64_t, 3>& globalSize,
+                                              const std::array<uint64_t, 3>& boxLow,
+                                              const std::array<uint64_t, 3>& boxSize)
+{
+    return std::make_unique<H5GridWriter>(comm, globalSize, boxLow, boxSize);
 }
 
 class H5PartReader final : public IFileReader
@@ -152,8 +370,9 @@ public:
     using Base      = IFileReader;
     using FieldType = typename Base::FieldType;
 
-    explicit H5PartReader(MPI_Comm comm)
+    explicit H5PartReader(MPI_Comm comm, H5PartReadTuning tuning = {})
         : comm_(comm)
+        , tuning_(std::move(tuning))
         , h5File_{nullptr}
     {
         MPI_Comm_rank(comm, &rank_);
@@ -172,14 +391,29 @@ public:
      *
      * @param path  filesystem path
      * @param step  snapshot index to load from
-     * @param mode  collective mode causes MPI ranks to distribute particles amongst themselves,
-     *              independent mode causes all MPI ranks to load all particles
+     * @param mode  collective mode causes MPI ranks to distribute particles amongst themselves and read them with
+     *              collective MPI-IO, every rank then has to make the same readField calls.
+     *              independent mode causes all MPI ranks to load all particles with independent MPI-IO
      */
     void setStep(std::string path, int step, FileMode mode) override
     {
         closeStep();
         pathStep_ = path;
-        h5File_   = fileutils::openH5Part(path, H5PART_READ | H5PART_VFD_MPIIO_IND, comm_);
+
+        h5part_int64_t openMode = H5PART_READ;
+        if (mode == FileMode::independent) { openMode |= H5PART_VFD_MPIIO_IND; }
+
+        MPI_Info hints = MPI_INFO_NULL;
+        if (!tuning_.hints.empty())
+        {
+            MPI_Info_create(&hints);
+            for (const auto& [key, value] : tuning_.hints)
+            {
+                MPI_Info_set(hints, key.c_str(), value.c_str());
+            }
+        }
+        h5File_ = fileutils::openH5Part(path, openMode, comm_, hints);
+        if (hints != MPI_INFO_NULL) { MPI_Info_free(&hints); }
 
         if (H5PartGetNumSteps(h5File_) == 0) { return; }
 
@@ -196,13 +430,42 @@ public:
 
         if (mode == FileMode::collective)
         {
-            std::tie(firstIndex_, lastIndex_) = partitionRange(globalCount_, rank, numRanks);
-            localCount_                       = lastIndex_ - firstIndex_;
-            H5PartSetView(h5File_, firstIndex_, lastIndex_ - 1);
+            std::tie(firstIndex_, lastIndex_) = fileutils::partitionRange(globalCount_, rank, numRanks);
+            uint64_t elementBytes = coordinateElementBytes();
+            if (elementBytes > 0 && tuning_.alignBytes >= elementBytes)
+            {
+                // neighboring ranks round their shared boundary the same way, the ranges stay disjoint and complete
+                uint64_t alignment = tuning_.alignBytes / elementBytes;
+                auto     align     = [this, alignment](uint64_t b)
+                { return std::min((b + alignment / 2) / alignment * alignment, globalCount_); };
+                firstIndex_ = align(firstIndex_);
+                lastIndex_  = rank == numRanks - 1 ? globalCount_ : align(lastIndex_);
+            }
+            localCount_ = lastIndex_ - firstIndex_;
+            selectRange(firstIndex_, lastIndex_);
         }
         else { std::tie(firstIndex_, lastIndex_, localCount_) = std::make_tuple(0, globalCount_, globalCount_); }
     }
 
+    //! @brief bytes per element in the file of the step's "x" dataset, or of its first dataset without one
+    uint64_t coordinateElementBytes()
+    {
+        h5part_int64_t numDatasets = H5PartGetNumDatasets(h5File_);
+        h5part_int64_t type        = -1;
+        for (h5part_int64_t i = 0; i < numDatasets; i++)
+        {
+            char           name[256];
+            h5part_int64_t datasetType = 0;
+            if (H5PartGetDatasetInfo(h5File_, i, name, sizeof(name), &datasetType, nullptr) != H5PART_SUCCESS)
+            {
+                continue;
+            }
+            if (std::string(name) == "x") { return H5Tget_size(hid_t(datasetType)); }
+            if (type < 0) { type = datasetType; }
+        }
+        return type < 0 ? 0 : H5Tget_size(hid_t(type));
+    }
+
     std::vector<std::string> fileAttributes() override
     {
         if (h5File_) { return fileutils::fileAttributeNames(h5File_); }
@@ -255,12 +518,27 @@ public:
             val);
     }
 
+    //! @brief read into a buffer of any floating point type, HDF5 converts from the file's type chunk-wise while reading
     void readField(const std::string& key, FieldType field) override
     {
         auto err = std::visit([this, &key](auto arg) { return fileutils::readH5PartField(h5File_, key, arg); }, field);
         if (err != H5PART_SUCCESS) { throw std::runtime_error("Could not read field: " + key); }
     }
 
+    /*! @brief read only a block of the local particle range, e.g. to stream a checkpoint that does not fit in memory
+     *
+     * @param first  first local particle index of the block
+     * @param last   one past the last local particle index, must not exceed localNumParticles()
+     *
+     * readField() then fills last - first elements. An empty block selects nothing, in collective mode readField()
+     * still has to be called for it.
+     */
+    void setLocalView(uint64_t first, uint64_t last) override
+    {
+        if (last > localCount_ || first > last) { throw std::out_of_range("Local view exceeds local particle range\n"); }
+        selectRange(firstIndex_ + first, firstIndex_ + last);
+    }
+
     uint64_t localNumParticles() override { return localCount_; }
 
     uint64_t globalNumParticles() override { return globalCount_; }
@@ -275,6 +553,18 @@ public:
     }
 
 private:
+    //! @brief restrict reads to the global particle range [first:last), which may be empty
+    void selectRange(uint64_t first, uint64_t last)
+    {
+        if (first < last) { H5PartSetView(h5File_, first, last - 1); }
+        else
+        {
+            // H5PartSetView cannot express an empty range, an empty index list selects nothing
+            h5part_int64_t none = 0;
+            H5PartSetViewIndices(h5File_, &none, 0);
+        }
+    }
+
     int64_t stepAttributeIndex(const std::string& key)
     {
         auto    attributes = fileutils::stepAttributeNames(h5File_);
@@ -291,8 +581,9 @@ private:
         return attrIndex;
     }
 
-    int      rank_{0};
-    MPI_Comm comm_;
+    int              rank_{0};
+    MPI_Comm         comm_;
+    H5PartReadTuning tuning_;
 
     uint64_t    firstIndex_, lastIndex_;
     uint64_t    localCount_;
@@ -302,12 +593,30 @@ private:
     H5PartFile* h5File_;
 };
 
-std::unique_ptr<IFileReader> makeH5PartReader(MPI_Comm comm) { return std::make_unique<H5PartReader>(comm); }
+std::unique_ptr<IFileReader> makeH5PartReader(MPI_Comm comm, const H5PartReadTuning& tuning)
+{
+    return std::make_unique<H5PartReader>(comm, tuning);
+}
+
+bool h5ThreadSafe()
+{
+    hbool_t threadSafe = 0;
+    return H5is_library_threadsafe(&threadSafe) >= 0 && threadSafe;
+}
 
 #else
 
 std::unique_ptr<IFileWriter> makeH5PartWriter(MPI_Comm) { return {}; }
-std::unique_ptr<IFileReader> makeH5PartReader(MPI_Comm) { return std::make_unique<UnimplementedReader>(); }
+std::unique_ptr<IFileWriter> makeH5GridWriter(MPI_Comm, const std::array<uint64_t, 3>&, const std::array<uint64_t, 3>&,
+                                              const std::array<uint64_t, 3>&)
+{
+    return {};
+}
+std::unique_ptr<IFileReader> makeH5PartReader(MPI_Comm, const H5PartReadTuning&)
+{
+    return std::make_unique<UnimplementedReader>();
+}
+bool h5ThreadSafe() { return true; }
 
 #endif
 
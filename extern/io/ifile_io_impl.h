@@ -1,6 +1,11 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 #include <mpi.h>
 
 #include "ifile_io.hpp"
@@ -11,6 +16,38 @@ namespace sphexa
 std::unique_ptr<IFileWriter> makeAsciiWriter(MPI_Comm comm);
 std::unique_ptr<IFileWriter> makeH5PartWriter(MPI_Comm comm);
 
-std::unique_ptr<IFileReader> makeH5PartReader(MPI_Comm comm);
+/*! @brief HDF5 writer of a distributed 3D grid, each rank owning the box [boxLow, boxLow + boxSize)
+ *
+ * Sizes are given x first, in the order of a heFFTe box with x fastest in memory. Each writeField() call writes one
+ * root-level dataset of shape (z, y, x).
+ */
+std::unique_ptr<IFileWriter> makeH5GridWriter(MPI_Comm comm, const std::array<uint64_t, 3>& globalSize,
+                                              const std::array<uint64_t, 3>& boxLow,
+                                              const std::array<uint64_t, 3>& boxSize);
+
+//! @brief MPI-IO tuning of the H5Part reader, ignored without parallel HDF5
+struct H5PartReadTuning
+{
+    //! hints for MPI_File_open, e.g. {"romio_cb_read", "enable"}, {"cb_nodes", "8"}, {"cb_buffer_size", "16777216"}
+    std::vector<std::pair<std::string, std::string>> hints;
+    //! round the rank boundaries of collective reads to multiples of this many bytes of the coordinates, 0 = off
+    uint64_t alignBytes{0};
+};
+
+std::unique_ptr<IFileReader> makeH5PartReader(MPI_Comm comm, const H5PartReadTuning& tuning = {});
+
+//! @brief whether HDF5 calls may be made from several threads at once, true without HDF5
+bool h5ThreadSafe();
+
+//! @brief columnar raw binary steps, one file per field, read back through mmap
+std::unique_ptr<IFileWriter> makeRawWriter(MPI_Comm comm);
+std::unique_ptr<IFileReader> makeRawReader(MPI_Comm comm);
+
+//! @brief directory of @p step below the raw root directory @p root, the path RawWriter::addStep expects
+std::string rawStepDirectory(const std::string& root, int step);
+//! @brief fields stored for @p step, empty if the step has not been written
+std::vector<std::string> rawStepFields(const std::string& root, int step);
+//! @brief number of particles stored for @p step, 0 if the step has not been written
+uint64_t rawStepNumParticles(const std::string& root, int step);
 
 } // namespace sphexa
@@ -0,0 +1,423 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 CSCS, ETH Zurich, University of Basel, University of Zurich
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*! @file
+ * @brief Columnar raw binary particle files, read through mmap
+ *
+ * A step is a directory with one native-endian binary file per field and a text header listing the number of
+ * particles and the element type of each field:
+ *
+ *     numParticles 16777216
+ *     x double
+ *     vx float
+ */
+
+#include <fcntl.h>
+#include <mpi.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <tuple>
+#include <variant>
+#include <vector>
+
+#include "file_utils.hpp"
+#include "ifile_io_impl.h"
+
+namespace sphexa
+{
+
+namespace
+{
+
+template<class T>
+constexpr const char* rawTypeName()
+{
+    if constexpr (std::is_same_v<T, double>) { return "double"; }
+    else if constexpr (std::is_same_v<T, float>) { return "float"; }
+    else if constexpr (std::is_same_v<T, char>) { return "char"; }
+    else if constexpr (std::is_same_v<T, int>) { return "int"; }
+    else if constexpr (std::is_same_v<T, int64_t>) { return "int64"; }
+    else if constexpr (std::is_same_v<T, unsigned>) { return "unsigned"; }
+    else { return "uint64"; }
+}
+
+//! @brief call f with a null pointer of the element type named @p type
+template<class F>
+void visitRawType(const std::string& type, F&& f)
+{
+    bool found = false;
+    auto test  = [&](auto* ptr)
+    {
+        using T = std::remove_pointer_t<decltype(ptr)>;
+        if (!found && type == rawTypeName<T>())
+        {
+            found = true;
+            f(ptr);
+        }
+    };
+    std::apply([&](auto... ptrs) { (test(ptrs), ...); },
+               std::tuple<double*, float*, char*, int*, int64_t*, unsigned*, uint64_t*>{});
+    if (!found) { throw std::runtime_error("Unknown raw field type: " + type); }
+}
+
+struct RawHeader
+{
+    uint64_t                           numParticles{0};
+    std::map<std::string, std::string> fieldTypes;
+};
+
+//! @brief read the header of a raw step directory, returns false if there is none
+bool readRawHeader(const std::string& stepDir, RawHeader& header)
+{
+    std::ifstream in(stepDir + "/header");
+    if (!in.is_open()) { return false; }
+
+    std::string key;
+    in >> key >> header.numParticles;
+    if (key != "numParticles") { throw std::runtime_error("Malformed raw header in " + stepDir); }
+
+    std::string field, type;
+    while (in >> field >> type)
+    {
+        header.fieldTypes[field] = type;
+    }
+    return true;
+}
+
+} // namespace
+
+std::string rawStepDirectory(const std::string& root, int step) { return root + "/step_" + std::to_string(step); }
+
+std::vector<std::string> rawStepFields(const std::string& root, int step)
+{
+    RawHeader                header;
+    std::vector<std::string> fields;
+    if (readRawHeader(rawStepDirectory(root, step), header))
+    {
+        for (const auto& [field, type] : header.fieldTypes)
+        {
+            fields.push_back(field);
+        }
+    }
+    return fields;
+}
+
+uint64_t rawStepNumParticles(const std::string& root, int step)
+{
+    RawHeader header;
+    return readRawHeader(rawStepDirectory(root, step), header) ? header.numParticles : 0;
+}
+
+/*! @brief writes one step of local particle fields into a raw step directory
+ *
+ * Every rank writes its particles at its global offset with pwrite, rank 0 merges the written fields into the header
+ * of an existing step with the same number of particles, so fields can be added to a step later on.
+ */
+class RawWriter final : public IFileWriter
+{
+public:
+    using Base      = IFileWriter;
+    using FieldType = typename Base::FieldType;
+
+    explicit RawWriter(MPI_Comm comm)
+        : comm_(comm)
+    {
+        MPI_Comm_rank(comm, &rank_);
+        MPI_Comm_size(comm, &numRanks_);
+    }
+
+    ~RawWriter() override { closeStep(); }
+
+    [[nodiscard]] int rank() const override { return rank_; }
+    [[nodiscard]] int numRanks() const override { return numRanks_; }
+
+    std::string suffix() const override { return ".raw"; }
+
+    //! @brief @p path is the step directory, see rawStepDirectory()
+    void addStep(size_t firstIndex, size_t lastIndex, std::string path) override
+    {
+        closeStep();
+        firstIndex_ = firstIndex;
+        stepDir_    = path;
+
+        numLocal_ = lastIndex - firstIndex;
+        offset_   = 0;
+        MPI_Exscan(&numLocal_, &offset_, 1, MPI_UINT64_T, MPI_SUM, comm_);
+        if (rank_ == 0) { offset_ = 0; }
+        MPI_Allreduce(&numLocal_, &numGlobal_, 1, MPI_UINT64_T, MPI_SUM, comm_);
+
+        if (rank_ == 0) { std::filesystem::create_directories(stepDir_); }
+        MPI_Barrier(comm_);
+    }
+
+    void stepAttribute(const std::string&, FieldType, int64_t) override {}
+    void fileAttribute(const std::string&, FieldType, int64_t) override {}
+
+    void writeField(const std::string& key, FieldType field, int = 0) override
+    {
+        std::visit(
+            [this, &key](auto arg)
+            {
+                using T = std::remove_const_t<std::remove_pointer_t<decltype(arg)>>;
+                fieldTypes_[key] = rawTypeName<T>();
+                writeColumn(stepDir_ + "/" + key, arg + firstIndex_, sizeof(T));
+            },
+            field);
+    }
+
+    void closeStep() override
+    {
+        if (stepDir_.empty()) { return; }
+        MPI_Barrier(comm_);
+        if (rank_ == 0)
+        {
+            RawHeader header;
+            if (!readRawHeader(stepDir_, header) || header.numParticles != numGlobal_) { header = RawHeader{}; }
+            header.numParticles = numGlobal_;
+            for (const auto& [field, type] : fieldTypes_)
+            {
+                header.fieldTypes[field] = type;
+            }
+
+            // written next to the old header and renamed, readers never see a partial one
+            std::string tmp = stepDir_ + "/header.tmp";
+            {
+                std::ofstream out(tmp);
+                out << "numParticles " << header.numParticles << "\n";
+                for (const auto& [field, type] : header.fieldTypes)
+                {
+                    out << field << " " << type << "\n";
+                }
+                if (!out) { throw std::runtime_error("Could not write raw header in " + stepDir_); }
+            }
+            std::filesystem::rename(tmp, stepDir_ + "/header");
+        }
+        MPI_Barrier(comm_);
+        stepDir_.clear();
+        fieldTypes_.clear();
+    }
+
+private:
+    void writeColumn(const std::string& path, const void* data, size_t elementSize) const
+    {
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+        if (fd < 0) { throw std::runtime_error("Could not open raw field file " + path); }
+
+        // the last rank sizes the file, so a shorter file left by an earlier step with fewer particles is cut off
+        if (rank_ == numRanks_ - 1 && ::ftruncate(fd, numGlobal_ * elementSize) != 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("Could not resize raw field file " + path);
+        }
+
+        size_t      remaining = numLocal_ * elementSize;
+        const char* src       = static_cast<const char*>(data);
+        off_t       pos       = offset_ * elementSize;
+        while (remaining > 0)
+        {
+            ssize_t written = ::pwrite(fd, src, remaining, pos);
+            if (written <= 0)
+            {
+                ::close(fd);
+                throw std::runtime_error("Could not write raw field file " + path);
+            }
+            src += written, pos += written, remaining -= written;
+        }
+        ::close(fd);
+    }
+
+    int      rank_{0}, numRanks_{0};
+    MPI_Comm comm_;
+
+    size_t      firstIndex_{0};
+    uint64_t    offset_{0};
+    uint64_t    numLocal_{0};
+    uint64_t    numGlobal_{0};
+    std::string stepDir_;
+
+    std::map<std::string, std::string> fieldTypes_;
+};
+
+/*! @brief reads raw step directories through read-only memory maps
+ *
+ * Each field file is mapped once per step on first use, readField() then copies or converts the selected elements
+ * straight out of the page cache, there is no decoding or staging buffer in between. Ranks share the particles like
+ * the collective H5Part reader does. The files do not store attributes.
+ */
+class RawReader final : public IFileReader
+{
+public:
+    using Base      = IFileReader;
+    using FieldType = typename Base::FieldType;
+
+    explicit RawReader(MPI_Comm comm)
+        : comm_(comm)
+    {
+        MPI_Comm_rank(comm, &rank_);
+        MPI_Comm_size(comm, &numRanks_);
+    }
+
+    ~RawReader() override { closeStep(); }
+
+    [[nodiscard]] int     rank() const override { return rank_; }
+    [[nodiscard]] int64_t numParticles() const override { return header_.numParticles; }
+
+    //! @brief @p path is the root directory of the raw steps, negative steps are not supported
+    void setStep(std::string path, int step, FileMode mode) override
+    {
+        closeStep();
+        stepDir_ = rawStepDirectory(path, step);
+        header_  = RawHeader{};
+        if (!readRawHeader(stepDir_, header_)) { throw std::runtime_error("No raw particle step at " + stepDir_); }
+
+        if (mode == FileMode::collective)
+        {
+            std::tie(firstIndex_, lastIndex_) = fileutils::partitionRange(header_.numParticles, rank_, numRanks_);
+        }
+        else { std::tie(firstIndex_, lastIndex_) = std::make_tuple(0, header_.numParticles); }
+        viewFirst_ = firstIndex_;
+        viewLast_  = lastIndex_;
+    }
+
+    std::vector<std::string> fileAttributes() override { return {}; }
+    std::vector<std::string> stepAttributes() override { return {}; }
+
+    int64_t fileAttributeSize(const std::string& key) override { throw noAttribute(key); }
+    int64_t stepAttributeSize(const std::string& key) override { throw noAttribute(key); }
+    void    fileAttribute(const std::string& key, FieldType, int64_t) override { throw noAttribute(key); }
+    void    stepAttribute(const std::string& key, FieldType, int64_t) override { throw noAttribute(key); }
+
+    //! @brief copy the selected elements of a field into a buffer of any type, converting if the stored type differs
+    void readField(const std::string& key, FieldType field) override
+    {
+        auto it = header_.fieldTypes.find(key);
+        if (it == header_.fieldTypes.end()) { throw std::runtime_error("Could not read field: " + key); }
+        // an empty view has nothing to copy, a step without particles does not even have a mapping
+        if (viewLast_ == viewFirst_) { return; }
+
+        const char* base = mapField(key);
+        visitRawType(it->second,
+                     [this, base, field](auto* typeTag)
+                     {
+                         using S         = std::remove_pointer_t<decltype(typeTag)>;
+                         const S* source = reinterpret_cast<const S*>(base) + viewFirst_;
+                         size_t   count  = viewLast_ - viewFirst_;
+                         std::visit(
+                             [source, count](auto* dest)
+                             {
+                                 using D = std::remove_pointer_t<decltype(dest)>;
+                                 if constexpr (std::is_same_v<S, D>) { std::memcpy(dest, source, count * sizeof(S)); }
+                                 else { std::copy_n(source, count, dest); }
+                             },
+                             field);
+                     });
+    }
+
+    void setLocalView(uint64_t first, uint64_t last) override
+    {
+        if (last > lastIndex_ - firstIndex_ || first > last)
+        {
+            throw std::out_of_range("Local view exceeds local particle range\n");
+        }
+        viewFirst_ = firstIndex_ + first;
+        viewLast_  = firstIndex_ + last;
+    }
+
+    uint64_t localNumParticles() override { return lastIndex_ - firstIndex_; }
+    uint64_t globalNumParticles() override { return header_.numParticles; }
+
+    void closeStep() override
+    {
+        for (auto& [key, mapping] : mappings_)
+        {
+            ::munmap(mapping.first, mapping.second);
+        }
+        mappings_.clear();
+        stepDir_.clear();
+    }
+
+private:
+    //! @brief map the whole field file, the kernel only pages in what this rank touches
+    const char* mapField(const std::string& key)
+    {
+        auto it = mappings_.find(key);
+        if (it != mappings_.end()) { return static_cast<const char*>(it->second.first); }
+
+        size_t      elementSize = 0;
+        std::string path        = stepDir_ + "/" + key;
+        visitRawType(header_.fieldTypes.at(key),
+                     [&elementSize](auto* typeTag) { elementSize = sizeof(*typeTag); });
+        size_t bytes = header_.numParticles * elementSize;
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) { throw std::runtime_error("Could not open raw field file " + path); }
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || size_t(st.st_size) < bytes)
+        {
+            ::close(fd);
+            throw std::runtime_error("Raw field file " + path + " is shorter than its header says");
+        }
+        if (bytes == 0)
+        {
+            ::close(fd);
+            return nullptr;
+        }
+
+        void* addr = ::mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED) { throw std::runtime_error("Could not map raw field file " + path); }
+        ::madvise(addr, bytes, MADV_SEQUENTIAL);
+
+        mappings_[key] = {addr, bytes};
+        return static_cast<const char*>(addr);
+    }
+
+    static std::out_of_range noAttribute(const std::string& key)
+    {
+        return std::out_of_range("Attribute " + key + " does not exist\n");
+    }
+
+    int      rank_{0}, numRanks_{0};
+    MPI_Comm comm_;
+
+    RawHeader   header_;
+    std::string stepDir_;
+    uint64_t    firstIndex_{0}, lastIndex_{0};
+    uint64_t    viewFirst_{0}, viewLast_{0};
+
+    std::map<std::string, std::pair<void*, size_t>> mappings_;
+};
+
+std::unique_ptr<IFileWriter> makeRawWriter(MPI_Comm comm) { return std::make_unique<RawWriter>(comm); }
+std::unique_ptr<IFileReader> makeRawReader(MPI_Comm comm) { return std::make_unique<RawReader>(comm); }
+
+} // namespace sphexa
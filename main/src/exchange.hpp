@@ -0,0 +1,550 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <mpi.h>
+
+#include "cstone/primitives/mpi_wrappers.hpp"
+
+// Wire-format and communication helpers for the rasterizer all-to-all exchanges.
+//
+// Each exchange comes in a dense flavor (MPI_Alltoall/MPI_Alltoallv over all ranks) and a sparse flavor that only
+// talks to ranks with nonzero counts. With Hilbert-ordered particles a rank overlaps only a handful of FFT boxes, so
+// the sparse flavor keeps the exchange cost independent of the total number of ranks.
+//
+// Cell indices are local to the receiving heFFTe inbox and are sent as 32-bit integers. Optionally, the index stream
+// to each rank is delta encoded (zigzag, so unsorted runs work as well) and packed into base-128 varints. Since
+// particles are SFC-ordered, consecutive indices to the same rank are close and most deltas fit into one or two bytes.
+
+//! @brief append @p value to @p out as a base-128 varint (7 bits per byte, high bit set on all but the last byte)
+inline void appendVarint(std::vector<uint8_t>& out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<uint8_t>(value) | 0x80);
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+//! @brief read one varint starting at @p pos, advances @p pos past it
+inline uint64_t readVarint(const uint8_t* bytes, size_t& pos)
+{
+    uint64_t value = 0;
+    int      shift = 0;
+    uint8_t  b;
+    do
+    {
+        b = bytes[pos++];
+        value |= uint64_t(b & 0x7f) << shift;
+        shift += 7;
+    } while (b & 0x80);
+    return value;
+}
+
+inline uint64_t zigzagEncode(int64_t v) { return (uint64_t(v) << 1) ^ uint64_t(v >> 63); }
+inline int64_t  zigzagDecode(uint64_t v) { return int64_t(v >> 1) ^ -int64_t(v & 1); }
+
+/*! @brief delta/varint-encode the per-rank segments of an all-to-all index buffer
+ *
+ * @param[in]  indices    flattened indices, segment r is [disp[r], disp[r] + count[r])
+ * @param[in]  count      number of indices per destination rank
+ * @param[in]  disp       segment offsets into @p indices
+ * @param[out] bytes      encoded streams, concatenated in rank order
+ * @param[out] byteCount  number of encoded bytes per destination rank
+ * @param[out] byteDisp   offsets of the encoded streams in @p bytes, size count.size() + 1
+ */
+inline void encodeIndexStreams(const std::vector<uint32_t>& indices, const std::vector<int>& count,
+                               const std::vector<int>& disp, std::vector<uint8_t>& bytes, std::vector<int>& byteCount,
+                               std::vector<int>& byteDisp)
+{
+    int numRanks = count.size();
+    bytes.clear();
+    byteCount.assign(numRanks, 0);
+    byteDisp.assign(numRanks + 1, 0);
+
+    for (int r = 0; r < numRanks; r++)
+    {
+        int64_t prev = 0;
+        for (int j = disp[r]; j < disp[r] + count[r]; j++)
+        {
+            appendVarint(bytes, zigzagEncode(int64_t(indices[j]) - prev));
+            prev = indices[j];
+        }
+        byteDisp[r + 1] = bytes.size();
+        byteCount[r]    = byteDisp[r + 1] - byteDisp[r];
+    }
+}
+
+//! @brief decode one segment of @p count indices written by encodeIndexStreams
+inline void decodeIndexSegment(const uint8_t* bytes, int count, uint32_t* indices)
+{
+    size_t  pos  = 0;
+    int64_t prev = 0;
+    for (int j = 0; j < count; j++)
+    {
+        prev       = prev + zigzagDecode(readVarint(bytes, pos));
+        indices[j] = static_cast<uint32_t>(prev);
+    }
+}
+
+//! @brief inverse of encodeIndexStreams, @p indices must be sized to hold all decoded segments
+inline void decodeIndexStreams(const std::vector<uint8_t>& bytes, const std::vector<int>& byteDisp,
+                               const std::vector<int>& count, const std::vector<int>& disp,
+                               std::vector<uint32_t>& indices)
+{
+    int numRanks = count.size();
+#pragma omp parallel for schedule(dynamic)
+    for (int r = 0; r < numRanks; r++)
+    {
+        decodeIndexSegment(bytes.data() + byteDisp[r], count[r], indices.data() + disp[r]);
+    }
+}
+
+//! @brief returns a fresh tag for each sparse exchange, all ranks call the exchanges in the same order
+inline int nextExchangeTag()
+{
+    static int counter = 0;
+    counter            = (counter + 1) % 4096;
+    return 1000 + counter;
+}
+
+/*! @brief exchange per-rank element counts, the sparse replacement for MPI_Alltoall(sendCount -> recvCount)
+ *
+ * The sparse path uses the non-blocking consensus algorithm (NBX, Hoefler et al. 2010): counts are sent with
+ * synchronous sends to nonzero peers only, received via probing, and a non-blocking barrier detects termination.
+ * Messages and memory per rank are proportional to the number of peers rather than to the communicator size.
+ */
+inline void exchangeCounts(const std::vector<int>& sendCount, std::vector<int>& recvCount, bool sparse, MPI_Comm comm)
+{
+    if (!sparse)
+    {
+        MPI_Alltoall(sendCount.data(), 1, MpiType<int>{}, recvCount.data(), 1, MpiType<int>{}, comm);
+        return;
+    }
+
+    int tag = nextExchangeTag();
+    std::fill(recvCount.begin(), recvCount.end(), 0);
+
+    std::vector<MPI_Request> sendRequests;
+    for (size_t r = 0; r < sendCount.size(); r++)
+    {
+        if (sendCount[r] == 0) continue;
+        sendRequests.emplace_back();
+        MPI_Issend(&sendCount[r], 1, MpiType<int>{}, r, tag, comm, &sendRequests.back());
+    }
+
+    MPI_Request barrier;
+    bool        barrierActive = false;
+    while (true)
+    {
+        int        hasMessage;
+        MPI_Status status;
+        MPI_Iprobe(MPI_ANY_SOURCE, tag, comm, &hasMessage, &status);
+        if (hasMessage)
+        {
+            MPI_Recv(&recvCount[status.MPI_SOURCE], 1, MpiType<int>{}, status.MPI_SOURCE, tag, comm,
+                     MPI_STATUS_IGNORE);
+        }
+
+        if (barrierActive)
+        {
+            int barrierDone;
+            MPI_Test(&barrier, &barrierDone, MPI_STATUS_IGNORE);
+            if (barrierDone) break;
+        }
+        else
+        {
+            int sendsDone;
+            MPI_Testall(sendRequests.size(), sendRequests.data(), &sendsDone, MPI_STATUSES_IGNORE);
+            if (sendsDone)
+            {
+                MPI_Ibarrier(comm, &barrier);
+                barrierActive = true;
+            }
+        }
+    }
+}
+
+/*! @brief the sparse replacement for MPI_Alltoallv, point-to-point messages to/from ranks with nonzero counts only
+ *
+ * Counts and displacements have the same meaning as for MPI_Alltoallv and must be consistent across ranks,
+ * e.g. obtained with exchangeCounts.
+ */
+template<class Tv>
+void exchangeValues(const Tv* send, const std::vector<int>& sendCount, const std::vector<int>& sendDisp, Tv* recv,
+                    const std::vector<int>& recvCount, const std::vector<int>& recvDisp, bool sparse, MPI_Comm comm)
+{
+    if (!sparse)
+    {
+        MPI_Alltoallv(send, sendCount.data(), sendDisp.data(), MpiType<Tv>{}, recv, recvCount.data(),
+                      recvDisp.data(), MpiType<Tv>{}, comm);
+        return;
+    }
+
+    int                      tag = nextExchangeTag();
+    std::vector<MPI_Request> requests;
+    for (size_t r = 0; r < recvCount.size(); r++)
+    {
+        if (recvCount[r] == 0) continue;
+        requests.emplace_back();
+        MPI_Irecv(recv + recvDisp[r], recvCount[r], MpiType<Tv>{}, r, tag, comm, &requests.back());
+    }
+    for (size_t r = 0; r < sendCount.size(); r++)
+    {
+        if (sendCount[r] == 0) continue;
+        requests.emplace_back();
+        MPI_Isend(send + sendDisp[r], sendCount[r], MpiType<Tv>{}, r, tag, comm, &requests.back());
+    }
+    MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+}
+
+/*! @brief exchangeValues with 64-bit counts and displacements
+ *
+ * Exchanges whose displacements fit into MPI's int go through exchangeValues. Larger ones are sent point-to-point to
+ * ranks with nonzero counts, split into messages of at most @p maxMessage elements. Messages from one peer share a
+ * tag and arrive in order.
+ */
+template<class Tv>
+void exchangeValues(const Tv* send, const std::vector<uint64_t>& sendCount, const std::vector<uint64_t>& sendDisp,
+                    Tv* recv, const std::vector<uint64_t>& recvCount, const std::vector<uint64_t>& recvDisp,
+                    bool sparse, MPI_Comm comm, uint64_t maxMessage = std::numeric_limits<int>::max())
+{
+    size_t   numRanks  = sendCount.size();
+    uint64_t sendTotal = std::accumulate(sendCount.begin(), sendCount.end(), uint64_t(0));
+    uint64_t recvTotal = std::accumulate(recvCount.begin(), recvCount.end(), uint64_t(0));
+    uint64_t maxEnd    = 0;
+    for (size_t r = 0; r < numRanks; r++)
+    {
+        maxEnd = std::max({maxEnd, sendDisp[r] + sendCount[r], recvDisp[r] + recvCount[r]});
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &maxEnd, 1, MpiType<uint64_t>{}, MPI_MAX, comm);
+
+    if (maxEnd <= maxMessage)
+    {
+        std::vector<int> sc(sendCount.begin(), sendCount.end()), sd(sendDisp.begin(), sendDisp.begin() + numRanks);
+        std::vector<int> rc(recvCount.begin(), recvCount.end()), rd(recvDisp.begin(), recvDisp.begin() + numRanks);
+        exchangeValues(send, sc, sd, recv, rc, rd, sparse, comm);
+        return;
+    }
+
+    int                      tag = nextExchangeTag();
+    std::vector<MPI_Request> requests;
+    requests.reserve((sendTotal + recvTotal) / maxMessage + 2 * numRanks);
+    for (size_t r = 0; r < numRanks; r++)
+    {
+        for (uint64_t offset = 0; offset < recvCount[r]; offset += maxMessage)
+        {
+            requests.emplace_back();
+            MPI_Irecv(recv + recvDisp[r] + offset, int(std::min(maxMessage, recvCount[r] - offset)), MpiType<Tv>{}, r,
+                      tag, comm, &requests.back());
+        }
+    }
+    for (size_t r = 0; r < numRanks; r++)
+    {
+        for (uint64_t offset = 0; offset < sendCount[r]; offset += maxMessage)
+        {
+            requests.emplace_back();
+            MPI_Isend(send + sendDisp[r] + offset, int(std::min(maxMessage, sendCount[r] - offset)), MpiType<Tv>{}, r,
+                      tag, comm, &requests.back());
+        }
+    }
+    MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+}
+
+/*! @brief exchange the encoded byte counts of compressed index streams
+ *
+ * Ranks exchanging no indices exchange no bytes either, so the sparse path sends one count per index peer and
+ * skips peer discovery.
+ */
+inline void exchangeByteCounts(const std::vector<int>& sendCount, const std::vector<int>& recvCount,
+                               const std::vector<int>& sendByteCount, std::vector<int>& recvByteCount, bool sparse,
+                               MPI_Comm comm)
+{
+    int numRanks = sendCount.size();
+    if (!sparse)
+    {
+        MPI_Alltoall(sendByteCount.data(), 1, MpiType<int>{}, recvByteCount.data(), 1, MpiType<int>{}, comm);
+        return;
+    }
+
+    std::vector<int> sendOne(numRanks), recvOne(numRanks), rankDisp(numRanks);
+    std::iota(rankDisp.begin(), rankDisp.end(), 0);
+    for (int r = 0; r < numRanks; r++)
+    {
+        sendOne[r] = sendCount[r] > 0;
+        recvOne[r] = recvCount[r] > 0;
+    }
+    std::fill(recvByteCount.begin(), recvByteCount.end(), 0);
+    exchangeValues(sendByteCount.data(), sendOne, rankDisp, recvByteCount.data(), recvOne, rankDisp, true, comm);
+}
+
+/*! @brief exchange 32-bit local cell indices with the counts/displacements of the accompanying value exchange
+ *
+ * With @p compress the per-rank index streams are delta/varint encoded, which costs one extra exchange of the
+ * encoded byte counts but typically shrinks the index payload by 2-4x compared to raw 32-bit indices.
+ */
+inline void exchangeIndices(const std::vector<uint32_t>& sendIndex, const std::vector<int>& sendCount,
+                            const std::vector<int>& sendDisp, std::vector<uint32_t>& recvIndex,
+                            const std::vector<int>& recvCount, const std::vector<int>& recvDisp, bool compress,
+                            bool sparse, MPI_Comm comm)
+{
+    if (!compress)
+    {
+        exchangeValues(sendIndex.data(), sendCount, sendDisp, recvIndex.data(), recvCount, recvDisp, sparse, comm);
+        return;
+    }
+
+    int                  numRanks = sendCount.size();
+    std::vector<uint8_t> sendBytes, recvBytes;
+    std::vector<int>     sendByteCount, sendByteDisp;
+    std::vector<int>     recvByteCount(numRanks), recvByteDisp(numRanks + 1, 0);
+
+    encodeIndexStreams(sendIndex, sendCount, sendDisp, sendBytes, sendByteCount, sendByteDisp);
+
+    exchangeByteCounts(sendCount, recvCount, sendByteCount, recvByteCount, sparse, comm);
+    for (int r = 0; r < numRanks; r++)
+    {
+        recvByteDisp[r + 1] = recvByteDisp[r] + recvByteCount[r];
+    }
+    recvBytes.resize(recvByteDisp[numRanks]);
+
+    exchangeValues(sendBytes.data(), sendByteCount, sendByteDisp, recvBytes.data(), recvByteCount, recvByteDisp,
+                   sparse, comm);
+
+    decodeIndexStreams(recvBytes, recvByteDisp, recvCount, recvDisp, recvIndex);
+}
+
+/*! @brief non-blocking exchange of several fields that share one set of counts, drained peer by peer
+ *
+ * Fields are posted one after the other with Isend/Irecv to ranks with nonzero counts. The caller can then do local
+ * work while the messages are in flight and finally call drain(), which hands each source rank to a callback as soon
+ * as all fields from that rank have arrived. Send and receive buffers must stay alive and untouched until drain()
+ * returns.
+ */
+class PendingExchange
+{
+public:
+    PendingExchange(const std::vector<int>& sendCount, const std::vector<int>& sendDisp,
+                    const std::vector<int>& recvCount, const std::vector<int>& recvDisp, MPI_Comm comm)
+        : sendCount_(sendCount)
+        , sendDisp_(sendDisp)
+        , recvCount_(recvCount)
+        , recvDisp_(recvDisp)
+        , comm_(comm)
+    {
+    }
+
+    PendingExchange(const PendingExchange&)            = delete;
+    PendingExchange& operator=(const PendingExchange&) = delete;
+
+    template<class Tv>
+    void post(const Tv* send, Tv* recv)
+    {
+        post(send, sendCount_, sendDisp_, recv, recvCount_, recvDisp_);
+    }
+
+    /*! @brief post the cell index field, delta/varint encoded if @p compress is set
+     *
+     * The encoded byte counts are exchanged right away, so this is the only blocking step of the exchange.
+     * Segments are decoded into @p recvIndex in drain() before the callback sees them.
+     */
+    void postIndices(const std::vector<uint32_t>& sendIndex, std::vector<uint32_t>& recvIndex, bool compress)
+    {
+        if (!compress)
+        {
+            post(sendIndex.data(), recvIndex.data());
+            return;
+        }
+
+        int numRanks = sendCount_.size();
+        encodeIndexStreams(sendIndex, sendCount_, sendDisp_, sendBytes_, sendByteCount_, sendByteDisp_);
+        recvByteCount_.resize(numRanks);
+        exchangeByteCounts(sendCount_, recvCount_, sendByteCount_, recvByteCount_, true, comm_);
+
+        recvByteDisp_.assign(numRanks + 1, 0);
+        for (int r = 0; r < numRanks; r++)
+        {
+            recvByteDisp_[r + 1] = recvByteDisp_[r] + recvByteCount_[r];
+        }
+        recvBytes_.resize(recvByteDisp_[numRanks]);
+        decodeTarget_ = &recvIndex;
+
+        post(sendBytes_.data(), sendByteCount_, sendByteDisp_, recvBytes_.data(), recvByteCount_, recvByteDisp_);
+    }
+
+    //! @brief wait for all fields, calling @p apply(sourceRank) once all fields from sourceRank have arrived
+    template<class F>
+    void drain(F&& apply)
+    {
+        std::vector<int> remaining(recvCount_.size(), 0);
+        for (int r : recvPeers_)
+        {
+            remaining[r]++;
+        }
+
+        std::vector<int> done(recvRequests_.size());
+        int              numOpen = recvRequests_.size();
+        while (numOpen > 0)
+        {
+            int numDone;
+            MPI_Waitsome(recvRequests_.size(), recvRequests_.data(), &numDone, done.data(), MPI_STATUSES_IGNORE);
+            numOpen -= numDone;
+            for (int d = 0; d < numDone; d++)
+            {
+                int r = recvPeers_[done[d]];
+                if (--remaining[r] > 0) continue;
+
+                if (decodeTarget_)
+                {
+                    decodeIndexSegment(recvBytes_.data() + recvByteDisp_[r], recvCount_[r],
+                                       decodeTarget_->data() + recvDisp_[r]);
+                }
+                apply(r);
+            }
+        }
+        MPI_Waitall(sendRequests_.size(), sendRequests_.data(), MPI_STATUSES_IGNORE);
+        sendRequests_.clear();
+        recvRequests_.clear();
+        recvPeers_.clear();
+    }
+
+private:
+    template<class Tv>
+    void post(const Tv* send, const std::vector<int>& sendCount, const std::vector<int>& sendDisp, Tv* recv,
+              const std::vector<int>& recvCount, const std::vector<int>& recvDisp)
+    {
+        // peers are selected by the record counts, which also covers the byte streams of compressed indices
+        int tag = nextExchangeTag();
+        for (size_t r = 0; r < recvCount.size(); r++)
+        {
+            if (recvCount_[r] == 0) continue;
+            recvRequests_.emplace_back();
+            recvPeers_.push_back(r);
+            MPI_Irecv(recv + recvDisp[r], recvCount[r], MpiType<Tv>{}, r, tag, comm_, &recvRequests_.back());
+        }
+        for (size_t r = 0; r < sendCount.size(); r++)
+        {
+            if (sendCount_[r] == 0) continue;
+            sendRequests_.emplace_back();
+            MPI_Isend(send + sendDisp[r], sendCount[r], MpiType<Tv>{}, r, tag, comm_, &sendRequests_.back());
+        }
+    }
+
+    const std::vector<int>& sendCount_;
+    const std::vector<int>& sendDisp_;
+    const std::vector<int>& recvCount_;
+    const std::vector<int>& recvDisp_;
+    MPI_Comm                comm_;
+
+    std::vector<MPI_Request> sendRequests_;
+    std::vector<MPI_Request> recvRequests_;
+    //! source rank of each receive request
+    std::vector<int> recvPeers_;
+
+    std::vector<uint8_t>   sendBytes_, recvBytes_;
+    std::vector<int>       sendByteCount_, sendByteDisp_, recvByteCount_, recvByteDisp_;
+    std::vector<uint32_t>* decodeTarget_ = nullptr;
+};
+
+/*! @brief exchange (target rank, record) pairs in rounds of at most @p byteBudget bytes per rank and direction
+ *
+ * @param produce  produce(staging, capacity) appends records to staging until it holds capacity entries or the
+ *                 producer is exhausted, returns whether more records may follow
+ * @param apply    apply(records, count) is called with the records received in each round
+ *
+ * Each round, ranks offer their staged records, receivers grant at most capacity records in total (shared in proportion
+ * to the offers when oversubscribed) and only granted records are sent; the rest stays staged. Staging, send and
+ * receive buffers are allocated once with capacity = byteBudget / sizeof(Record) entries, so peak memory is bounded
+ * independently of particle count and load imbalance. Records are sent as raw bytes.
+ */
+template<class Record, class Produce, class Apply>
+void chunkedExchange(size_t byteBudget, Produce&& produce, Apply&& apply, bool sparse, MPI_Comm comm)
+{
+    static_assert(std::is_trivially_copyable_v<Record>);
+
+    int numRanks;
+    MPI_Comm_size(comm, &numRanks);
+    // byte counts and displacements of a round must fit into MPI's int counts
+    size_t maxCapacity = std::numeric_limits<int>::max() / sizeof(Record);
+    size_t capacity    = std::clamp<size_t>(byteBudget / sizeof(Record), 1, maxCapacity);
+
+    std::vector<std::pair<int, Record>> staging;
+    staging.reserve(capacity);
+    std::vector<Record> sendBuffer(capacity), recvBuffer(capacity);
+
+    std::vector<int> offer(numRanks), incoming(numRanks), grant(numRanks), granted(numRanks);
+    std::vector<int> sendOne(numRanks), recvOne(numRanks), rankDisp(numRanks);
+    std::vector<int> sendBytes(numRanks), sendByteDisp(numRanks + 1), recvBytes(numRanks), recvByteDisp(numRanks + 1);
+    std::vector<int> sendPos(numRanks);
+    std::iota(rankDisp.begin(), rankDisp.end(), 0);
+
+    bool more = true;
+    while (true)
+    {
+        if (more) { more = produce(staging, capacity); }
+
+        int localBusy = more || !staging.empty();
+        int busy;
+        MPI_Allreduce(&localBusy, &busy, 1, MpiType<int>{}, MPI_LOR, comm);
+        if (!busy) break;
+
+        std::fill(offer.begin(), offer.end(), 0);
+        for (const auto& entry : staging)
+        {
+            offer[entry.first]++;
+        }
+        exchangeCounts(offer, incoming, sparse, comm);
+
+        // receiver side: grant everything that fits, otherwise shares proportional to the offers
+        uint64_t totalIncoming = std::accumulate(incoming.begin(), incoming.end(), uint64_t(0));
+        uint64_t totalGrant    = 0;
+        for (int r = 0; r < numRanks; r++)
+        {
+            grant[r] = totalIncoming <= capacity ? incoming[r] : incoming[r] * capacity / totalIncoming;
+            totalGrant += grant[r];
+        }
+        if (totalIncoming > 0 && totalGrant == 0)
+        {
+            grant[std::max_element(incoming.begin(), incoming.end()) - incoming.begin()] = 1;
+        }
+
+        // return the grants to the offering ranks
+        for (int r = 0; r < numRanks; r++)
+        {
+            sendOne[r] = incoming[r] > 0;
+            recvOne[r] = offer[r] > 0;
+        }
+        std::fill(granted.begin(), granted.end(), 0);
+        exchangeValues(grant.data(), sendOne, rankDisp, granted.data(), recvOne, rankDisp, sparse, comm);
+
+        sendByteDisp[0] = recvByteDisp[0] = 0;
+        for (int r = 0; r < numRanks; r++)
+        {
+            sendBytes[r]        = granted[r] * sizeof(Record);
+            recvBytes[r]        = grant[r] * sizeof(Record);
+            sendByteDisp[r + 1] = sendByteDisp[r] + sendBytes[r];
+            recvByteDisp[r + 1] = recvByteDisp[r] + recvBytes[r];
+            sendPos[r]          = sendByteDisp[r] / sizeof(Record);
+        }
+
+        // pack the granted records per destination in staging order, keep the remainder for the next round
+        size_t keep = 0;
+        for (const auto& entry : staging)
+        {
+            int r = entry.first;
+            if (sendPos[r] * sizeof(Record) < size_t(sendByteDisp[r + 1])) { sendBuffer[sendPos[r]++] = entry.second; }
+            else { staging[keep++] = entry; }
+        }
+        staging.resize(keep);
+
+        exchangeValues(reinterpret_cast<const uint8_t*>(sendBuffer.data()), sendBytes, sendByteDisp,
+                       reinterpret_cast<uint8_t*>(recvBuffer.data()), recvBytes, recvByteDisp, sparse, comm);
+        apply(recvBuffer.data(), recvByteDisp[numRanks] / sizeof(Record));
+    }
+}
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <complex>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <mpi.h>
+
+#include "heffte.h"
+
+// heFFTe plan autotuning.
+//
+// The processor grid and the plan options (slabs or pencils, reordering, reshape algorithm) that transform a grid
+// fastest depend on the machine, the grid size and the rank count. tuneFft times a forward transform for every
+// combination, the winner is kept in a small text tuning file with one line per grid size, rank count and precision:
+//
+//     gridDim numRanks precisionBytes p0 p1 p2 pencils reorder algorithm secondsPerTransform
+//
+// Later runs look up their settings there and fall back to the min-surface processor grid and the heFFTe defaults.
+
+//! @brief heFFTe settings of one grid size and rank count
+struct FftTuning
+{
+    std::array<int, 3>        procGrid{0, 0, 0};
+    bool                      pencils   = false;
+    bool                      reorder   = true;
+    heffte::reshape_algorithm algorithm = heffte::reshape_algorithm::alltoallv;
+    double                    seconds   = 0; // time of one forward transform
+};
+
+inline const std::array<std::pair<heffte::reshape_algorithm, const char*>, 4> reshapeAlgorithmNames{
+    {{heffte::reshape_algorithm::alltoallv, "alltoallv"},
+     {heffte::reshape_algorithm::alltoall, "alltoall"},
+     {heffte::reshape_algorithm::p2p, "p2p"},
+     {heffte::reshape_algorithm::p2p_plined, "p2p_plined"}}};
+
+inline std::string reshapeAlgorithmName(heffte::reshape_algorithm algorithm)
+{
+    for (const auto& [value, name] : reshapeAlgorithmNames)
+    {
+        if (value == algorithm) { return name; }
+    }
+    return "unknown";
+}
+
+//! @brief all processor grids p0 x p1 x p2 = @p numRanks without more boxes than cells along any dimension
+inline std::vector<std::array<int, 3>> procGridCandidates(int gridDim, int numRanks)
+{
+    std::vector<std::array<int, 3>> grids;
+    for (int p0 = 1; p0 <= std::min(numRanks, gridDim); p0++)
+    {
+        if (numRanks % p0 != 0) { continue; }
+        for (int p1 = 1; p1 <= std::min(numRanks / p0, gridDim); p1++)
+        {
+            int p2 = numRanks / p0 / p1;
+            if ((numRanks / p0) % p1 == 0 && p2 <= gridDim) { grids.push_back({p0, p1, p2}); }
+        }
+    }
+    return grids;
+}
+
+/*! @brief time forward transforms of a @p gridDim^3 grid for all processor grids and plan options
+ *
+ * Each combination gets one untimed transform, then @p repetitions timed ones. The slowest rank's mean time counts,
+ * all ranks return the same winner.
+ */
+template<class T>
+FftTuning tuneFft(int gridDim, int rank, int numRanks, int repetitions = 5)
+{
+    heffte::box3d<> allIndexes({0, 0, 0}, {gridDim - 1, gridDim - 1, gridDim - 1});
+    FftTuning       best;
+    best.seconds = -1;
+
+    for (const auto& procGrid : procGridCandidates(gridDim, numRanks))
+    {
+        heffte::box3d<>              inbox = heffte::split_world(allIndexes, procGrid)[rank];
+        std::vector<T>               input(inbox.count());
+        std::vector<std::complex<T>> output(inbox.count());
+        for (size_t i = 0; i < input.size(); i++)
+        {
+            input[i] = T((i * 7919) % 1024) / 1024;
+        }
+
+        for (bool pencils : {false, true})
+        {
+            for (bool reorder : {false, true})
+            {
+                for (const auto& [algorithm, name] : reshapeAlgorithmNames)
+                {
+                    heffte::plan_options options = heffte::default_options<heffte::backend::fftw>();
+                    options.use_pencils          = pencils;
+                    options.use_reorder          = reorder;
+                    options.algorithm            = algorithm;
+                    heffte::fft3d<heffte::backend::fftw> fft(inbox, inbox, MPI_COMM_WORLD, options);
+
+                    fft.forward(input.data(), output.data(), heffte::scale::none);
+                    MPI_Barrier(MPI_COMM_WORLD);
+                    double start = MPI_Wtime();
+                    for (int r = 0; r < repetitions; r++)
+                    {
+                        fft.forward(input.data(), output.data(), heffte::scale::none);
+                    }
+                    double seconds = (MPI_Wtime() - start) / repetitions;
+                    MPI_Allreduce(MPI_IN_PLACE, &seconds, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+                    if (rank == 0)
+                    {
+                        std::printf("# fft tuning %d^3 grid %dx%dx%d pencils %d reorder %d %s: %g s\n", gridDim,
+                                    procGrid[0], procGrid[1], procGrid[2], pencils, reorder, name, seconds);
+                    }
+                    if (best.seconds < 0 || seconds < best.seconds)
+                    {
+                        best = FftTuning{procGrid, pencils, reorder, algorithm, seconds};
+                    }
+                }
+            }
+        }
+    }
+    return best;
+}
+
+//! @brief the tuning file entry of @p gridDim, @p numRanks and @p precision, read on rank 0 and broadcast
+inline std::optional<FftTuning> loadFftTuning(const std::string& path, int gridDim, int numRanks, int precision,
+                                              int rank)
+{
+    // found, p0, p1, p2, pencils, reorder, algorithm
+    std::array<int, 7> entry{0, 0, 0, 0, 0, 0, 0};
+    double             seconds = 0;
+    if (rank == 0)
+    {
+        std::ifstream in(path);
+        std::string   line;
+        while (std::getline(in, line))
+        {
+            std::istringstream fields(line);
+            int                dim = 0, ranks = 0, bytes = 0;
+            std::array<int, 3> grid{};
+            int                pencils = 0, reorder = 0;
+            std::string        name;
+            double             time = 0;
+            if (!(fields >> dim >> ranks >> bytes >> grid[0] >> grid[1] >> grid[2] >> pencils >> reorder >> name >>
+                  time) ||
+                dim != gridDim || ranks != numRanks || bytes != precision || grid[0] * grid[1] * grid[2] != numRanks)
+            {
+                continue;
+            }
+            for (const auto& [value, algorithmName] : reshapeAlgorithmNames)
+            {
+                if (name == algorithmName)
+                {
+                    entry   = {1, grid[0], grid[1], grid[2], pencils, reorder, static_cast<int>(value)};
+                    seconds = time;
+                }
+            }
+        }
+    }
+    MPI_Bcast(entry.data(), entry.size(), MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Bcast(&seconds, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    if (!entry[0]) { return std::nullopt; }
+
+    return FftTuning{{entry[1], entry[2], entry[3]},
+                     entry[4] != 0,
+                     entry[5] != 0,
+                     static_cast<heffte::reshape_algorithm>(entry[6]),
+                     seconds};
+}
+
+//! @brief replace the tuning file entry of @p gridDim, @p numRanks and @p precision with @p tuning, called on one rank
+inline void storeFftTuning(const std::string& path, int gridDim, int numRanks, int precision, const FftTuning& tuning)
+{
+    std::vector<std::string> lines;
+    {
+        std::ifstream in(path);
+        std::string   line;
+        while (std::getline(in, line))
+        {
+            std::istringstream fields(line);
+            int                dim = 0, ranks = 0, bytes = 0;
+            fields >> dim >> ranks >> bytes;
+            if (fields && dim == gridDim && ranks == numRanks && bytes == precision) { continue; }
+            lines.push_back(line);
+        }
+    }
+
+    std::ostringstream entry;
+    entry << gridDim << ' ' << numRanks << ' ' << precision << ' ' << tuning.procGrid[0] << ' ' << tuning.procGrid[1]
+          << ' ' << tuning.procGrid[2] << ' ' << tuning.pencils << ' ' << tuning.reorder << ' '
+          << reshapeAlgorithmName(tuning.algorithm) << ' ' << tuning.seconds;
+    lines.push_back(entry.str());
+
+    // written under a temporary name and renamed, concurrent readers see the old or the new file
+    {
+        std::ofstream out(path + ".tmp");
+        for (const auto& line : lines)
+        {
+            out << line << '\n';
+        }
+        if (!out) { throw std::runtime_error("Could not write the FFT tuning file " + path); }
+    }
+    std::filesystem::rename(path + ".tmp", path);
+}
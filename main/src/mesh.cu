@@ -248,6 +248,13 @@ __global__ void packCellAvgByRankKernel(const int* remoteRanks, const uint64_t*
     sendVz[out]    = remoteVz[idx];
 }
 
+// Widen 32-bit wire-format cell indices to the 64-bit indices used by the device accumulation kernels.
+__global__ void widenIndicesKernel(const uint32_t* in, uint64_t* out, int count)
+{
+    int idx = blockIdx.x * blockDim.x + threadIdx.x;
+    if (idx < count) out[idx] = in[idx];
+}
+
 // Pass 1: atomically record the minimum distance per cell — no velocity writes.
 // Both local and recv variants share the same logic; a single kernel suffices.
 template<typename T>
@@ -477,7 +484,7 @@ void rasterize_particles_to_mesh_cuda(Mesh<T>& mesh, std::vector<KeyType> keys,
         {
             int targetRank = h_remoteRanks[i];
             mesh.send_count[targetRank]++;
-            mesh.vdataSender[targetRank].send_index.push_back(h_remoteIndices[i]);
+            mesh.vdataSender[targetRank].send_index.push_back(static_cast<uint32_t>(h_remoteIndices[i]));
             mesh.vdataSender[targetRank].send_distance.push_back(h_remoteDistances[i]);
             mesh.vdataSender[targetRank].send_vx.push_back(h_remoteVx[i]);
             mesh.vdataSender[targetRank].send_vy.push_back(h_remoteVy[i]);
@@ -485,7 +492,7 @@ void rasterize_particles_to_mesh_cuda(Mesh<T>& mesh, std::vector<KeyType> keys,
         }
     }
 
-    MPI_Alltoall(mesh.send_count.data(), 1, MpiType<int>{}, mesh.recv_count.data(), 1, MpiType<int>{}, MPI_COMM_WORLD);
+    exchangeCounts(mesh.send_count, mesh.recv_count, mesh.sparseExchange_, MPI_COMM_WORLD);
 
     for (int i = 0; i < mesh.numRanks_; i++)
     {
@@ -562,16 +569,16 @@ void rasterize_particles_to_mesh_cuda(Mesh<T>& mesh, std::vector<KeyType> keys,
             checkCudaError(cudaMalloc(&d_recvVz, recvTotal * sizeof(T)), "Allocating d_recvVz");
         }
 
-        MPI_Alltoallv(d_sendIndexNN, mesh.send_count.data(), mesh.send_disp.data(), MpiType<uint64_t>{}, d_recvIndices,
-                      mesh.recv_count.data(), mesh.recv_disp.data(), MpiType<uint64_t>{}, MPI_COMM_WORLD);
-        MPI_Alltoallv(d_sendDistanceNN, mesh.send_count.data(), mesh.send_disp.data(), MpiType<T>{}, d_recvDistances,
-                      mesh.recv_count.data(), mesh.recv_disp.data(), MpiType<T>{}, MPI_COMM_WORLD);
-        MPI_Alltoallv(d_sendVxNN, mesh.send_count.data(), mesh.send_disp.data(), MpiType<T>{}, d_recvVx,
-                      mesh.recv_count.data(), mesh.recv_disp.data(), MpiType<T>{}, MPI_COMM_WORLD);
-        MPI_Alltoallv(d_sendVyNN, mesh.send_count.data(), mesh.send_disp.data(), MpiType<T>{}, d_recvVy,
-                      mesh.recv_count.data(), mesh.recv_disp.data(), MpiType<T>{}, MPI_COMM_WORLD);
-        MPI_Alltoallv(d_sendVzNN, mesh.send_count.data(), mesh.send_disp.data(), MpiType<T>{}, d_recvVz,
-                      mesh.recv_count.data(), mesh.recv_disp.data(), MpiType<T>{}, MPI_COMM_WORLD);
+        exchangeValues(d_sendIndexNN, mesh.send_count, mesh.send_disp, d_recvIndices, mesh.recv_count, mesh.recv_disp,
+                       mesh.sparseExchange_, MPI_COMM_WORLD);
+        exchangeValues(d_sendDistanceNN, mesh.send_count, mesh.send_disp, d_recvDistances, mesh.recv_count,
+                       mesh.recv_disp, mesh.sparseExchange_, MPI_COMM_WORLD);
+        exchangeValues(d_sendVxNN, mesh.send_count, mesh.send_disp, d_recvVx, mesh.recv_count, mesh.recv_disp,
+                       mesh.sparseExchange_, MPI_COMM_WORLD);
+        exchangeValues(d_sendVyNN, mesh.send_count, mesh.send_disp, d_recvVy, mesh.recv_count, mesh.recv_disp,
+                       mesh.sparseExchange_, MPI_COMM_WORLD);
+        exchangeValues(d_sendVzNN, mesh.send_count, mesh.send_disp, d_recvVz, mesh.recv_count, mesh.recv_disp,
+                       mesh.sparseExchange_, MPI_COMM_WORLD);
 
         if (d_sendIndexNN) cudaFree(d_sendIndexNN);
         if (d_sendDistanceNN) cudaFree(d_sendDistanceNN);
@@ -587,16 +594,16 @@ void rasterize_particles_to_mesh_cuda(Mesh<T>& mesh, std::vector<KeyType> keys,
         mesh.recv_vy.resize(recvTotal);
         mesh.recv_vz.resize(recvTotal);
 
-        MPI_Alltoallv(mesh.send_index.data(), mesh.send_count.data(), mesh.send_disp.data(), MpiType<uint64_t>{}, mesh.recv_index.data(),
-                      mesh.recv_count.data(), mesh.recv_disp.data(), MpiType<uint64_t>{}, MPI_COMM_WORLD);
-        MPI_Alltoallv(mesh.send_distance.data(), mesh.send_count.data(), mesh.send_disp.data(), MpiType<T>{}, mesh.recv_distance.data(),
-                      mesh.recv_count.data(), mesh.recv_disp.data(), MpiType<T>{}, MPI_COMM_WORLD);
-        MPI_Alltoallv(mesh.send_vx.data(), mesh.send_count.data(), mesh.send_disp.data(), MpiType<T>{}, mesh.recv_vx.data(),
-                      mesh.recv_count.data(), mesh.recv_disp.data(), MpiType<T>{}, MPI_COMM_WORLD);
-        MPI_Alltoallv(mesh.send_vy.data(), mesh.send_count.data(), mesh.send_disp.data(), MpiType<T>{}, mesh.recv_vy.data(),
-                      mesh.recv_count.data(), mesh.recv_disp.data(), MpiType<T>{}, MPI_COMM_WORLD);
-        MPI_Alltoallv(mesh.send_vz.data(), mesh.send_count.data(), mesh.send_disp.data(), MpiType<T>{}, mesh.recv_vz.data(),
-                      mesh.recv_count.data(), mesh.recv_disp.data(), MpiType<T>{}, MPI_COMM_WORLD);
+        exchangeIndices(mesh.send_index, mesh.send_count, mesh.send_disp, mesh.recv_index, mesh.recv_count,
+                        mesh.recv_disp, mesh.compressIndexExchange_, mesh.sparseExchange_, MPI_COMM_WORLD);
+        exchangeValues(mesh.send_distance.data(), mesh.send_count, mesh.send_disp, mesh.recv_distance.data(),
+                       mesh.recv_count, mesh.recv_disp, mesh.sparseExchange_, MPI_COMM_WORLD);
+        exchangeValues(mesh.send_vx.data(), mesh.send_count, mesh.send_disp, mesh.recv_vx.data(), mesh.recv_count,
+                       mesh.recv_disp, mesh.sparseExchange_, MPI_COMM_WORLD);
+        exchangeValues(mesh.send_vy.data(), mesh.send_count, mesh.send_disp, mesh.recv_vy.data(), mesh.recv_count,
+                       mesh.recv_disp, mesh.sparseExchange_, MPI_COMM_WORLD);
+        exchangeValues(mesh.send_vz.data(), mesh.send_count, mesh.send_disp, mesh.recv_vz.data(), mesh.recv_count,
+                       mesh.recv_disp, mesh.sparseExchange_, MPI_COMM_WORLD);
 
         if (recvTotal > 0)
         {
@@ -606,7 +613,8 @@ void rasterize_particles_to_mesh_cuda(Mesh<T>& mesh, std::vector<KeyType> keys,
             checkCudaError(cudaMalloc(&d_recvVy, recvTotal * sizeof(T)), "Allocating d_recvVy");
             checkCudaError(cudaMalloc(&d_recvVz, recvTotal * sizeof(T)), "Allocating d_recvVz");
 
-            checkCudaError(cudaMemcpy(d_recvIndices, mesh.recv_index.data(), recvTotal * sizeof(uint64_t), cudaMemcpyHostToDevice), "Copying recv indices to device");
+            std::vector<uint64_t> h_recvIndices(mesh.recv_index.begin(), mesh.recv_index.end());
+            checkCudaError(cudaMemcpy(d_recvIndices, h_recvIndices.data(), recvTotal * sizeof(uint64_t), cudaMemcpyHostToDevice), "Copying recv indices to device");
             checkCudaError(cudaMemcpy(d_recvDistances, mesh.recv_distance.data(), recvTotal * sizeof(T), cudaMemcpyHostToDevice), "Copying recv distances to device");
             checkCudaError(cudaMemcpy(d_recvVx, mesh.recv_vx.data(), recvTotal * sizeof(T), cudaMemcpyHostToDevice), "Copying recv vx to device");
             checkCudaError(cudaMemcpy(d_recvVy, mesh.recv_vy.data(), recvTotal * sizeof(T), cudaMemcpyHostToDevice), "Copying recv vy to device");
@@ -803,13 +811,12 @@ void rasterize_particles_to_density_cuda(Mesh<T>& mesh, std::vector<KeyType> key
         {
             int targetRank = h_remoteRanks[i];
             mesh.send_count_density[targetRank]++;
-            mesh.vdataSenderDensity[targetRank].send_index.push_back(h_remoteIndices[i]);
+            mesh.vdataSenderDensity[targetRank].send_index.push_back(static_cast<uint32_t>(h_remoteIndices[i]));
             mesh.vdataSenderDensity[targetRank].send_mass.push_back(mesh.particleMass_);
         }
     }
 
-    MPI_Alltoall(mesh.send_count_density.data(), 1, MpiType<int>{}, mesh.recv_count_density.data(), 1, MpiType<int>{},
-                 MPI_COMM_WORLD);
+    exchangeCounts(mesh.send_count_density, mesh.recv_count_density, mesh.sparseExchange_, MPI_COMM_WORLD);
     for (int i = 0; i < mesh.numRanks_; i++)
     {
         mesh.send_disp_density[i + 1] = mesh.send_disp_density[i] + mesh.send_count_density[i];
@@ -830,12 +837,12 @@ void rasterize_particles_to_density_cuda(Mesh<T>& mesh, std::vector<KeyType> key
 
     mesh.recv_index_density.resize(mesh.recv_disp_density[mesh.numRanks_]);
     mesh.recv_mass_density.resize(mesh.recv_disp_density[mesh.numRanks_]);
-    MPI_Alltoallv(mesh.send_index_density.data(), mesh.send_count_density.data(), mesh.send_disp_density.data(),
-                  MpiType<uint64_t>{}, mesh.recv_index_density.data(), mesh.recv_count_density.data(),
-                  mesh.recv_disp_density.data(), MpiType<uint64_t>{}, MPI_COMM_WORLD);
-    MPI_Alltoallv(mesh.send_mass_density.data(), mesh.send_count_density.data(), mesh.send_disp_density.data(),
-                  MpiType<T>{}, mesh.recv_mass_density.data(), mesh.recv_count_density.data(),
-                  mesh.recv_disp_density.data(), MpiType<T>{}, MPI_COMM_WORLD);
+    exchangeIndices(mesh.send_index_density, mesh.send_count_density, mesh.send_disp_density,
+                    mesh.recv_index_density, mesh.recv_count_density, mesh.recv_disp_density,
+                    mesh.compressIndexExchange_, mesh.sparseExchange_, MPI_COMM_WORLD);
+    exchangeValues(mesh.send_mass_density.data(), mesh.send_count_density, mesh.send_disp_density,
+                   mesh.recv_mass_density.data(), mesh.recv_count_density, mesh.recv_disp_density, mesh.sparseExchange_,
+                   MPI_COMM_WORLD);
 
     for (int i = 0; i < mesh.recv_disp_density[mesh.numRanks_]; i++)
     {
@@ -1631,7 +1638,7 @@ void rasterize_particles_to_mesh_sph_cuda(Mesh<T>& mesh, std::vector<KeyType> ke
         {
             if (h_remoteWeightSum[idx] <= T(0)) continue;
             mesh.send_count[targetRank]++;
-            sender.send_index.push_back(idx);
+            sender.send_index.push_back(static_cast<uint32_t>(idx));
             sender.send_weight.push_back(h_remoteWeightSum[idx]);
             sender.send_weighted_vx.push_back(h_remoteWeightedVelX[idx]);
             sender.send_weighted_vy.push_back(h_remoteWeightedVelY[idx]);
@@ -1649,7 +1656,7 @@ void rasterize_particles_to_mesh_sph_cuda(Mesh<T>& mesh, std::vector<KeyType> ke
     //     std::cout << "rank = " << mesh.rank_ << " send_count = " << mesh.send_count[i] << std::endl;
 
     // ========== MPI Communication ==========
-    MPI_Alltoall(mesh.send_count.data(), 1, MpiType<int>{}, mesh.recv_count.data(), 1, MpiType<int>{}, MPI_COMM_WORLD);
+    exchangeCounts(mesh.send_count, mesh.recv_count, mesh.sparseExchange_, MPI_COMM_WORLD);
 
     for (int i = 0; i < mesh.numRanks_; i++)
     {
@@ -1697,20 +1704,28 @@ void rasterize_particles_to_mesh_sph_cuda(Mesh<T>& mesh, std::vector<KeyType> ke
             checkCudaError(cudaMalloc(&d_recvWeightedVz, recvTotal * sizeof(T)), "Allocating d_recvWeightedVz");
         }
 
-        MPI_Alltoallv(mesh.send_index_sph.data(), mesh.send_count.data(), mesh.send_disp.data(), MpiType<uint64_t>{},
-                      d_recvIndices, mesh.recv_count.data(), mesh.recv_disp.data(), MpiType<uint64_t>{},
-                      MPI_COMM_WORLD);
-        MPI_Alltoallv(mesh.send_weight.data(), mesh.send_count.data(), mesh.send_disp.data(), MpiType<T>{},
-                      d_recvWeights, mesh.recv_count.data(), mesh.recv_disp.data(), MpiType<T>{}, MPI_COMM_WORLD);
-        MPI_Alltoallv(mesh.send_weighted_vx.data(), mesh.send_count.data(), mesh.send_disp.data(), MpiType<T>{},
-                      d_recvWeightedVx, mesh.recv_count.data(), mesh.recv_disp.data(), MpiType<T>{},
-                      MPI_COMM_WORLD);
-        MPI_Alltoallv(mesh.send_weighted_vy.data(), mesh.send_count.data(), mesh.send_disp.data(), MpiType<T>{},
-                      d_recvWeightedVy, mesh.recv_count.data(), mesh.recv_disp.data(), MpiType<T>{},
-                      MPI_COMM_WORLD);
-        MPI_Alltoallv(mesh.send_weighted_vz.data(), mesh.send_count.data(), mesh.send_disp.data(), MpiType<T>{},
-                      d_recvWeightedVz, mesh.recv_count.data(), mesh.recv_disp.data(), MpiType<T>{},
-                      MPI_COMM_WORLD);
+        uint32_t* d_recvIndices32 = nullptr;
+        if (recvTotal > 0)
+        {
+            checkCudaError(cudaMalloc(&d_recvIndices32, recvTotal * sizeof(uint32_t)), "Allocating d_recvIndices32");
+        }
+        exchangeValues(mesh.send_index_sph.data(), mesh.send_count, mesh.send_disp, d_recvIndices32, mesh.recv_count,
+                       mesh.recv_disp, mesh.sparseExchange_, MPI_COMM_WORLD);
+        if (recvTotal > 0)
+        {
+            widenIndicesKernel<<<(recvTotal + threadsPerBlock - 1) / threadsPerBlock, threadsPerBlock>>>(
+                d_recvIndices32, d_recvIndices, recvTotal);
+            checkCudaError(cudaDeviceSynchronize(), "Widening recv indices SPH");
+            cudaFree(d_recvIndices32);
+        }
+        exchangeValues(mesh.send_weight.data(), mesh.send_count, mesh.send_disp, d_recvWeights, mesh.recv_count,
+                       mesh.recv_disp, mesh.sparseExchange_, MPI_COMM_WORLD);
+        exchangeValues(mesh.send_weighted_vx.data(), mesh.send_count, mesh.send_disp, d_recvWeightedVx, mesh.recv_count,
+                       mesh.recv_disp, mesh.sparseExchange_, MPI_COMM_WORLD);
+        exchangeValues(mesh.send_weighted_vy.data(), mesh.send_count, mesh.send_disp, d_recvWeightedVy, mesh.recv_count,
+                       mesh.recv_disp, mesh.sparseExchange_, MPI_COMM_WORLD);
+        exchangeValues(mesh.send_weighted_vz.data(), mesh.send_count, mesh.send_disp, d_recvWeightedVz, mesh.recv_count,
+                       mesh.recv_disp, mesh.sparseExchange_, MPI_COMM_WORLD);
     }
     else
     {
@@ -1721,20 +1736,16 @@ void rasterize_particles_to_mesh_sph_cuda(Mesh<T>& mesh, std::vector<KeyType> ke
         mesh.recv_weighted_vy.resize(recvTotal);
         mesh.recv_weighted_vz.resize(recvTotal);
 
-        MPI_Alltoallv(mesh.send_index_sph.data(), mesh.send_count.data(), mesh.send_disp.data(), MpiType<uint64_t>{},
-                      mesh.recv_index_sph.data(), mesh.recv_count.data(), mesh.recv_disp.data(), MpiType<uint64_t>{},
-                      MPI_COMM_WORLD);
-        MPI_Alltoallv(mesh.send_weight.data(), mesh.send_count.data(), mesh.send_disp.data(), MpiType<T>{},
-                      mesh.recv_weight.data(), mesh.recv_count.data(), mesh.recv_disp.data(), MpiType<T>{}, MPI_COMM_WORLD);
-        MPI_Alltoallv(mesh.send_weighted_vx.data(), mesh.send_count.data(), mesh.send_disp.data(), MpiType<T>{},
-                      mesh.recv_weighted_vx.data(), mesh.recv_count.data(), mesh.recv_disp.data(), MpiType<T>{},
-                      MPI_COMM_WORLD);
-        MPI_Alltoallv(mesh.send_weighted_vy.data(), mesh.send_count.data(), mesh.send_disp.data(), MpiType<T>{},
-                      mesh.recv_weighted_vy.data(), mesh.recv_count.data(), mesh.recv_disp.data(), MpiType<T>{},
-                      MPI_COMM_WORLD);
-        MPI_Alltoallv(mesh.send_weighted_vz.data(), mesh.send_count.data(), mesh.send_disp.data(), MpiType<T>{},
-                      mesh.recv_weighted_vz.data(), mesh.recv_count.data(), mesh.recv_disp.data(), MpiType<T>{},
-                      MPI_COMM_WORLD);
+        exchangeIndices(mesh.send_index_sph, mesh.send_count, mesh.send_disp, mesh.recv_index_sph, mesh.recv_count,
+                        mesh.recv_disp, mesh.compressIndexExchange_, mesh.sparseExchange_, MPI_COMM_WORLD);
+        exchangeValues(mesh.send_weight.data(), mesh.send_count, mesh.send_disp, mesh.recv_weight.data(),
+                       mesh.recv_count, mesh.recv_disp, mesh.sparseExchange_, MPI_COMM_WORLD);
+        exchangeValues(mesh.send_weighted_vx.data(), mesh.send_count, mesh.send_disp, mesh.recv_weighted_vx.data(),
+                       mesh.recv_count, mesh.recv_disp, mesh.sparseExchange_, MPI_COMM_WORLD);
+        exchangeValues(mesh.send_weighted_vy.data(), mesh.send_count, mesh.send_disp, mesh.recv_weighted_vy.data(),
+                       mesh.recv_count, mesh.recv_disp, mesh.sparseExchange_, MPI_COMM_WORLD);
+        exchangeValues(mesh.send_weighted_vz.data(), mesh.send_count, mesh.send_disp, mesh.recv_weighted_vz.data(),
+                       mesh.recv_count, mesh.recv_disp, mesh.sparseExchange_, MPI_COMM_WORLD);
 
         if (recvTotal > 0)
         {
@@ -1744,7 +1755,8 @@ void rasterize_particles_to_mesh_sph_cuda(Mesh<T>& mesh, std::vector<KeyType> ke
             checkCudaError(cudaMalloc(&d_recvWeightedVy, recvTotal * sizeof(T)), "Allocating d_recvWeightedVy");
             checkCudaError(cudaMalloc(&d_recvWeightedVz, recvTotal * sizeof(T)), "Allocating d_recvWeightedVz");
 
-            checkCudaError(cudaMemcpy(d_recvIndices, mesh.recv_index_sph.data(), recvTotal * sizeof(uint64_t), cudaMemcpyHostToDevice),
+            std::vector<uint64_t> h_recvIndices(mesh.recv_index_sph.begin(), mesh.recv_index_sph.end());
+            checkCudaError(cudaMemcpy(d_recvIndices, h_recvIndices.data(), recvTotal * sizeof(uint64_t), cudaMemcpyHostToDevice),
                             "Copying recv indices to device");
             checkCudaError(cudaMemcpy(d_recvWeights, mesh.recv_weight.data(), recvTotal * sizeof(T), cudaMemcpyHostToDevice),
                             "Copying recv weights to device");
@@ -2094,14 +2106,14 @@ void rasterize_particles_to_mesh_cell_avg_cuda(Mesh<T>& mesh, std::vector<KeyTyp
         {
             int r = h_remoteRanks[i];
             mesh.send_count[r]++;
-            mesh.vdataSenderCellAvg[r].send_index.push_back(h_remoteIndices[i]);
+            mesh.vdataSenderCellAvg[r].send_index.push_back(static_cast<uint32_t>(h_remoteIndices[i]));
             mesh.vdataSenderCellAvg[r].send_vx.push_back(h_remoteVx[i]);
             mesh.vdataSenderCellAvg[r].send_vy.push_back(h_remoteVy[i]);
             mesh.vdataSenderCellAvg[r].send_vz.push_back(h_remoteVz[i]);
         }
     }
 
-    MPI_Alltoall(mesh.send_count.data(), 1, MpiType<int>{}, mesh.recv_count.data(), 1, MpiType<int>{}, MPI_COMM_WORLD);
+    exchangeCounts(mesh.send_count, mesh.recv_count, mesh.sparseExchange_, MPI_COMM_WORLD);
 
     for (int i = 0; i < mesh.numRanks_; i++)
     {
@@ -2173,14 +2185,14 @@ void rasterize_particles_to_mesh_cell_avg_cuda(Mesh<T>& mesh, std::vector<KeyTyp
             checkCudaError(cudaMalloc(&d_recvVz, recvTotal * sizeof(T)), "d_recvVz cavg");
         }
 
-        MPI_Alltoallv(d_sendIndexCavg, mesh.send_count.data(), mesh.send_disp.data(), MpiType<uint64_t>{},
-                      d_recvIndices, mesh.recv_count.data(), mesh.recv_disp.data(), MpiType<uint64_t>{}, MPI_COMM_WORLD);
-        MPI_Alltoallv(d_sendVxCavg, mesh.send_count.data(), mesh.send_disp.data(), MpiType<T>{},
-                      d_recvVx, mesh.recv_count.data(), mesh.recv_disp.data(), MpiType<T>{}, MPI_COMM_WORLD);
-        MPI_Alltoallv(d_sendVyCavg, mesh.send_count.data(), mesh.send_disp.data(), MpiType<T>{},
-                      d_recvVy, mesh.recv_count.data(), mesh.recv_disp.data(), MpiType<T>{}, MPI_COMM_WORLD);
-        MPI_Alltoallv(d_sendVzCavg, mesh.send_count.data(), mesh.send_disp.data(), MpiType<T>{},
-                      d_recvVz, mesh.recv_count.data(), mesh.recv_disp.data(), MpiType<T>{}, MPI_COMM_WORLD);
+        exchangeValues(d_sendIndexCavg, mesh.send_count, mesh.send_disp, d_recvIndices, mesh.recv_count, mesh.recv_disp,
+                       mesh.sparseExchange_, MPI_COMM_WORLD);
+        exchangeValues(d_sendVxCavg, mesh.send_count, mesh.send_disp, d_recvVx, mesh.recv_count, mesh.recv_disp,
+                       mesh.sparseExchange_, MPI_COMM_WORLD);
+        exchangeValues(d_sendVyCavg, mesh.send_count, mesh.send_disp, d_recvVy, mesh.recv_count, mesh.recv_disp,
+                       mesh.sparseExchange_, MPI_COMM_WORLD);
+        exchangeValues(d_sendVzCavg, mesh.send_count, mesh.send_disp, d_recvVz, mesh.recv_count, mesh.recv_disp,
+                       mesh.sparseExchange_, MPI_COMM_WORLD);
 
         if (d_sendIndexCavg) cudaFree(d_sendIndexCavg);
         if (d_sendVxCavg) cudaFree(d_sendVxCavg);
@@ -2194,14 +2206,14 @@ void rasterize_particles_to_mesh_cell_avg_cuda(Mesh<T>& mesh, std::vector<KeyTyp
         mesh.recv_vy_cavg.resize(recvTotal);
         mesh.recv_vz_cavg.resize(recvTotal);
 
-        MPI_Alltoallv(mesh.send_index_cavg.data(), mesh.send_count.data(), mesh.send_disp.data(), MpiType<uint64_t>{},
-                      mesh.recv_index_cavg.data(), mesh.recv_count.data(), mesh.recv_disp.data(), MpiType<uint64_t>{}, MPI_COMM_WORLD);
-        MPI_Alltoallv(mesh.send_vx_cavg.data(), mesh.send_count.data(), mesh.send_disp.data(), MpiType<T>{},
-                      mesh.recv_vx_cavg.data(), mesh.recv_count.data(), mesh.recv_disp.data(), MpiType<T>{}, MPI_COMM_WORLD);
-        MPI_Alltoallv(mesh.send_vy_cavg.data(), mesh.send_count.data(), mesh.send_disp.data(), MpiType<T>{},
-                      mesh.recv_vy_cavg.data(), mesh.recv_count.data(), mesh.recv_disp.data(), MpiType<T>{}, MPI_COMM_WORLD);
-        MPI_Alltoallv(mesh.send_vz_cavg.data(), mesh.send_count.data(), mesh.send_disp.data(), MpiType<T>{},
-                      mesh.recv_vz_cavg.data(), mesh.recv_count.data(), mesh.recv_disp.data(), MpiType<T>{}, MPI_COMM_WORLD);
+        exchangeIndices(mesh.send_index_cavg, mesh.send_count, mesh.send_disp, mesh.recv_index_cavg, mesh.recv_count,
+                        mesh.recv_disp, mesh.compressIndexExchange_, mesh.sparseExchange_, MPI_COMM_WORLD);
+        exchangeValues(mesh.send_vx_cavg.data(), mesh.send_count, mesh.send_disp, mesh.recv_vx_cavg.data(),
+                       mesh.recv_count, mesh.recv_disp, mesh.sparseExchange_, MPI_COMM_WORLD);
+        exchangeValues(mesh.send_vy_cavg.data(), mesh.send_count, mesh.send_disp, mesh.recv_vy_cavg.data(),
+                       mesh.recv_count, mesh.recv_disp, mesh.sparseExchange_, MPI_COMM_WORLD);
+        exchangeValues(mesh.send_vz_cavg.data(), mesh.send_count, mesh.send_disp, mesh.recv_vz_cavg.data(),
+                       mesh.recv_count, mesh.recv_disp, mesh.sparseExchange_, MPI_COMM_WORLD);
 
         if (recvTotal > 0)
         {
@@ -2210,7 +2222,8 @@ void rasterize_particles_to_mesh_cell_avg_cuda(Mesh<T>& mesh, std::vector<KeyTyp
             checkCudaError(cudaMalloc(&d_recvVy,      recvTotal * sizeof(T)),        "d_recvVy cavg");
             checkCudaError(cudaMalloc(&d_recvVz,      recvTotal * sizeof(T)),        "d_recvVz cavg");
 
-            checkCudaError(cudaMemcpy(d_recvIndices, mesh.recv_index_cavg.data(), recvTotal * sizeof(uint64_t), cudaMemcpyHostToDevice), "cp recv idx cavg");
+            std::vector<uint64_t> h_recvIndices(mesh.recv_index_cavg.begin(), mesh.recv_index_cavg.end());
+            checkCudaError(cudaMemcpy(d_recvIndices, h_recvIndices.data(), recvTotal * sizeof(uint64_t), cudaMemcpyHostToDevice), "cp recv idx cavg");
             checkCudaError(cudaMemcpy(d_recvVx,      mesh.recv_vx_cavg.data(),    recvTotal * sizeof(T),        cudaMemcpyHostToDevice), "cp recv vx cavg");
             checkCudaError(cudaMemcpy(d_recvVy,      mesh.recv_vy_cavg.data(),    recvTotal * sizeof(T),        cudaMemcpyHostToDevice), "cp recv vy cavg");
             checkCudaError(cudaMemcpy(d_recvVz,      mesh.recv_vz_cavg.data(),    recvTotal * sizeof(T),        cudaMemcpyHostToDevice), "cp recv vz cavg");
@@ -1,13 +1,18 @@
 #pragma once
 
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
 #include <vector>
 #include <limits>
+#include <memory>
 #include <numbers>
 #include <iostream>
 #include <cstdlib>
 #include <unordered_map>
 #include "heffte.h"
 #include "cstone/domain/domain.hpp"
+#include "exchange.hpp"
 #ifdef USE_CUDA
 #include <cuda_runtime.h>
 #include <complex>
@@ -35,7 +40,7 @@ void launchExtrapolateEmptyCellsKernel(const T* srcVelX, const T* srcVelY, const
 struct DataSender
 {
     // vectors to send to each rank in all_to_allv
-    std::vector<uint64_t> send_index;
+    std::vector<uint32_t> send_index;
     std::vector<double>   send_distance;
     std::vector<double>   send_vx;
     std::vector<double>   send_vy;
@@ -45,7 +50,7 @@ struct DataSender
 struct DataSenderSPH
 {
     // vectors to send to each rank in all_to_allv for SPH interpolation
-    std::vector<uint64_t> send_index;
+    std::vector<uint32_t> send_index;
     std::vector<double>   send_weight;
     std::vector<double>   send_weighted_vx;
     std::vector<double>   send_weighted_vy;
@@ -55,16 +60,18 @@ struct DataSenderSPH
 struct DataSenderCellAvg
 {
     // vectors to send to each rank in all_to_allv for cell-average interpolation
-    std::vector<uint64_t> send_index;
+    // one entry per remote cell run: velocity sums and the number of particles contributing to them
+    std::vector<uint32_t> send_index;
     std::vector<double>   send_vx;
     std::vector<double>   send_vy;
     std::vector<double>   send_vz;
+    std::vector<int>      send_npart;
 };
 
 struct DataSenderDensity
 {
-    // vectors to send to each rank in all_to_allv for density accumulation
-    std::vector<uint64_t> send_index;
+    // vectors to send to each rank in all_to_allv for density accumulation, one mass sum per remote cell run
+    std::vector<uint32_t> send_index;
     std::vector<double>   send_mass;
 };
 
@@ -81,6 +88,18 @@ public:
     bool               usePencils_ = false; // heFFTe decomposition: false=slabs, true=pencils
     bool               useCudaAwareMpi_ = false; // use device pointers in MPI_Alltoallv for CUDA rasterizers
     bool               useCudaAwareGpuPack_ = false; // full GPU rank-pack path (experimental)
+    bool               compressIndexExchange_ = false; // delta/varint-encode cell indices in CPU exchanges
+    bool               sparseExchange_ = false; // point-to-point exchanges with nonzero peers instead of MPI_Alltoall(v)
+    bool               overlapExchange_ = false; // deposit local particles while remote records are in flight
+    bool               subgridReshape_ = false; // additive rasterizers deposit into one box per inbox, then sum them
+    size_t             exchangeBudgetBytes_ = 0; // per-round byte budget of chunked exchanges, 0 = single round
+    bool               accumulateBlocks_ = false; // between beginBlocks/endBlocks: keep accumulators, defer finalizing
+    bool               helmholtzSplit_ = false; // also bin the compressive and solenoidal parts of the velocity spectrum
+    bool               scalarField_ = false; // velX_ holds a scalar field, velY_ and velZ_ are not transformed or binned
+    int                cylinderAxis_ = -1; // 0, 1 or 2: also bin E(k_par, k_perp) about the x, y or z axis
+    // heFFTe plan options besides usePencils_, set before the first transform
+    bool                      fftReorder_   = heffte::default_options<heffte::backend::fftw>().use_reorder;
+    heffte::reshape_algorithm fftAlgorithm_ = heffte::default_options<heffte::backend::fftw>().algorithm;
     std::array<int, 3> proc_grid_;
 
     heffte::box3d<> inbox_;
@@ -98,6 +117,17 @@ public:
     T              particleMass_ = T(1);
     // particle's distance to mesh point
     std::vector<T> distance_;
+    // per-mode compressive power of the last FFT with helmholtzSplit_
+    std::vector<T> compressive_;
+    // ascending |k| edges of the shells set by setShellEdges, empty for integer shells round(|k|)
+    std::vector<T> shellEdges_;
+    // shell of each local mode, -1 outside the edges, built on first use since the inbox never changes
+    std::vector<int> shellOfMode_;
+    // cylindrical bin of each local mode about cylinderBinAxis_, -1 outside the k_perp shell edges
+    std::vector<int> cylinderBinOfMode_;
+    int              cylinderBinAxis_ = -1;
+    // sum of k_perp over the local modes of each cylindrical bin, fixed by the inbox like the bins themselves
+    std::vector<T> cylinderKPerpSum_;
     
 #ifdef USE_CUDA
     // Device pointers for velocity arrays (kept on GPU after CUDA rasterization)
@@ -119,6 +149,19 @@ public:
     }
 #endif
     std::vector<T> power_spectrum_;
+    // per-shell number of modes, unnormalized power sum and mean |k| of the (merged) bin, rank 0 only
+    std::vector<int> shellCounts_;
+    std::vector<T>   shellPower_;
+    std::vector<T>   shellK_;
+    int              shellMinCount_ = 0; // bins were merged until they held this many modes
+    // Helmholtz split of power_spectrum_ with helmholtzSplit_, normalized like it, rank 0 only
+    std::vector<T> compressiveSpectrum_;
+    std::vector<T> solenoidalSpectrum_;
+    // power sums and mode counts of the cylindrical bins with cylinderAxis_, rank 0 only. Row-major over
+    // k_par = 0 .. gridDim/2 and the k_perp shells, which are binned like the spherical ones.
+    std::vector<T>   cylinderPower_;
+    std::vector<int> cylinderCounts_;
+    std::vector<T>   cylinderKPerp_; // mean k_perp of the modes of each bin, 0 for empty bins
 
     // communication counters
     std::vector<int> send_disp;  //(numRanks_+1, 0);
@@ -130,14 +173,14 @@ public:
     std::vector<DataSender> vdataSender;
 
     // flattened send buffers assembled from vdataSender before all_to_allv
-    std::vector<uint64_t> send_index;
+    std::vector<uint32_t> send_index;
     std::vector<T>        send_distance;
     std::vector<T>        send_vx;
     std::vector<T>        send_vy;
     std::vector<T>        send_vz;
 
     // vectors to receive from each rank in all_to_allv
-    std::vector<uint64_t> recv_index;
+    std::vector<uint32_t> recv_index;
     std::vector<T>        recv_distance;
     std::vector<T>        recv_vx;
     std::vector<T>        recv_vy;
@@ -149,12 +192,12 @@ public:
     std::vector<T>             weightedVelX_;   // weighted velocity sum for each cell
     std::vector<T>             weightedVelY_;   // weighted velocity sum for each cell
     std::vector<T>             weightedVelZ_;   // weighted velocity sum for each cell
-    std::vector<uint64_t>      send_index_sph;
+    std::vector<uint32_t>      send_index_sph;
     std::vector<T>             send_weight;
     std::vector<T>             send_weighted_vx;
     std::vector<T>             send_weighted_vy;
     std::vector<T>             send_weighted_vz;
-    std::vector<uint64_t>      recv_index_sph;
+    std::vector<uint32_t>      recv_index_sph;
     std::vector<T>             recv_weight;
     std::vector<T>             recv_weighted_vx;
     std::vector<T>             recv_weighted_vy;
@@ -166,14 +209,16 @@ public:
     std::vector<T>                 cellAvgVelY_;
     std::vector<T>                 cellAvgVelZ_;
     std::vector<int>               cellCount_;    // particle count per cell
-    std::vector<uint64_t>          send_index_cavg;
+    std::vector<uint32_t>          send_index_cavg;
     std::vector<T>                 send_vx_cavg;
     std::vector<T>                 send_vy_cavg;
     std::vector<T>                 send_vz_cavg;
-    std::vector<uint64_t>          recv_index_cavg;
+    std::vector<int>               send_npart_cavg;
+    std::vector<uint32_t>          recv_index_cavg;
     std::vector<T>                 recv_vx_cavg;
     std::vector<T>                 recv_vy_cavg;
     std::vector<T>                 recv_vz_cavg;
+    std::vector<int>               recv_npart_cavg;
 
     // Density accumulation data structures
     std::vector<DataSenderDensity> vdataSenderDensity;
@@ -181,23 +226,31 @@ public:
     std::vector<int>               send_count_density;
     std::vector<int>               recv_disp_density;
     std::vector<int>               recv_count_density;
-    std::vector<uint64_t>          send_index_density;
+    std::vector<uint32_t>          send_index_density;
     std::vector<T>                 send_mass_density;
-    std::vector<uint64_t>          recv_index_density;
+    std::vector<uint32_t>          recv_index_density;
     std::vector<T>                 recv_mass_density;
 
-    // sim box -0.5 to 0.5 by default
-    Mesh(int rank, int numRanks, int gridDim, int numShells)
+    // particles deposited locally while the remote exchange is in flight (overlapExchange_)
+    std::vector<int> deferredParticles_;
+
+    // CPU FFT plan, built on the first transform and reused for later ones, copies of the mesh share it
+    std::shared_ptr<heffte::fft3d<heffte::backend::fftw>> fftPlan_;
+
+    // sim box -0.5 to 0.5 by default, a @p procGrid that does not multiply to numRanks selects the min-surface grid
+    Mesh(int rank, int numRanks, int gridDim, int numShells, std::array<int, 3> procGrid = {0, 0, 0})
         : rank_(rank)
         , numRanks_(numRanks)
         , gridDim_(gridDim)
         , numShells_(numShells)
         , Lmin_(-0.5)
         , Lmax_(0.5)
-        , inbox_(initInbox())
+        , inbox_(initInbox(procGrid))
     {
         uint64_t inboxSize = static_cast<uint64_t>(inbox_.size[0]) * static_cast<uint64_t>(inbox_.size[1]) *
                              static_cast<uint64_t>(inbox_.size[2]);
+        // local cell indices are exchanged as 32-bit integers
+        assert(inboxSize <= std::numeric_limits<uint32_t>::max());
         // std::cout << "rank = " << rank << " griddim = " << gridDim << " inboxSize = " << inboxSize << std::endl;
         // std::cout << "rank = " << rank << " inbox low = " << inbox_.low[0] << " " << inbox_.low[1] << " "
         //           << inbox_.low[2] << std::endl;
@@ -233,15 +286,228 @@ public:
         setCoordinates(Lmin_, Lmax_);
     }
 
-    void rasterize_particles_to_mesh(const std::vector<KeyType>& keys, const std::vector<T>& x, const std::vector<T>& y,
-                                     const std::vector<T>& z, const std::vector<T>& vx, const std::vector<T>& vy,
-                                     const std::vector<T>& vz, int powerDim)
+    /*! @brief bin modes into the shells [edges[b], edges[b+1]) instead of integer |k| shells
+     *
+     * The last shell includes its upper edge, modes outside the edges are not binned. numShells_ becomes the number of
+     * shells. The spectrum is normalized with the mean k^2 of the modes in each shell, which is an energy density per
+     * unit k for shells of any width.
+     */
+    void setShellEdges(std::vector<T> edges)
+    {
+        if (!validShellEdges(edges))
+        {
+            throw std::invalid_argument("Shell edges must be at least two ascending values");
+        }
+        shellEdges_ = std::move(edges);
+        numShells_  = shellEdges_.size() - 1;
+        power_spectrum_.assign(numShells_, T(0));
+        shellOfMode_.clear();
+        cylinderBinOfMode_.clear();
+    }
+
+    //! @brief whether @p edges are at least two strictly ascending values
+    static bool validShellEdges(const std::vector<T>& edges)
+    {
+        return edges.size() >= 2 &&
+               std::adjacent_find(edges.begin(), edges.end(), std::greater_equal<T>{}) == edges.end();
+    }
+
+    //! @brief @p numShells logarithmically spaced shells between @p kmin and @p kmax
+    static std::vector<T> logShellEdges(T kmin, T kmax, int numShells)
+    {
+        if (kmin <= 0 || kmax <= kmin || numShells < 1)
+        {
+            throw std::invalid_argument("Log shells need 0 < kmin < kmax and at least one shell");
+        }
+        std::vector<T> edges(numShells + 1);
+        for (int i = 0; i <= numShells; i++)
+        {
+            edges[i] = kmin * std::pow(kmax / kmin, T(i) / numShells);
+        }
+        return edges;
+    }
+
+    //! @brief shell of a mode with wave number @p kmag, -1 if it lies outside the shell edges
+    int shellIndex(T kmag) const
+    {
+        if (shellEdges_.empty()) { return std::min(static_cast<int>(std::round(kmag)), numShells_ - 1); }
+        if (kmag == shellEdges_.back()) { return numShells_ - 1; }
+        auto upper = std::upper_bound(shellEdges_.begin(), shellEdges_.end(), kmag);
+        if (upper == shellEdges_.begin() || upper == shellEdges_.end()) { return -1; }
+        return static_cast<int>(upper - shellEdges_.begin()) - 1;
+    }
+
+    //! @brief free the velY_ and velZ_ grids of a mesh that only computes scalar spectra
+    void releaseVectorComponents()
+    {
+        scalarField_ = true;
+        std::vector<T>().swap(velY_);
+        std::vector<T>().swap(velZ_);
+    }
+
+    //! @brief clear the rasterized fields and all accumulators, e.g. to rasterize the next step into the same mesh
+    void resetRasterFields()
+    {
+        std::fill(velX_.begin(), velX_.end(), T(0));
+        std::fill(velY_.begin(), velY_.end(), T(0));
+        std::fill(velZ_.begin(), velZ_.end(), T(0));
+        std::fill(distance_.begin(), distance_.end(), std::numeric_limits<T>::infinity());
+        std::fill(massSum_.begin(), massSum_.end(), T(0));
+        std::fill(density_.begin(), density_.end(), T(0));
+        std::fill(weightSum_.begin(), weightSum_.end(), T(0));
+        std::fill(weightedVelX_.begin(), weightedVelX_.end(), T(0));
+        std::fill(weightedVelY_.begin(), weightedVelY_.end(), T(0));
+        std::fill(weightedVelZ_.begin(), weightedVelZ_.end(), T(0));
+        std::fill(cellAvgVelX_.begin(), cellAvgVelX_.end(), T(0));
+        std::fill(cellAvgVelY_.begin(), cellAvgVelY_.end(), T(0));
+        std::fill(cellAvgVelZ_.begin(), cellAvgVelZ_.end(), T(0));
+        std::fill(cellCount_.begin(), cellCount_.end(), 0);
+    }
+
+    /*! @brief start a block-wise rasterization
+     *
+     * Clears all accumulators. Until endBlocks(), rasterizer calls add to the grid instead of starting over and skip
+     * their finalization (averaging, extrapolation), so particles can be rasterized in blocks of any size. Every rank
+     * must make the same number of rasterizer calls, passing empty blocks if it runs out of particles.
+     */
+    void beginBlocks()
+    {
+        resetRasterFields();
+        accumulateBlocks_ = true;
+    }
+
+    //! @brief end a block-wise rasterization, the caller then runs the finalization of the rasterizer it used
+    void endBlocks() { accumulateBlocks_ = false; }
+
+    // The rasterizers take particle fields of any floating point type P, e.g. float checkpoints rasterized into a
+    // double mesh without converting the particles first. Deposited values are accumulated in the mesh type T.
+
+    /*! @brief fill this mesh with the averages of @p fine over the fine cells within each of its cells
+     *
+     * The grid size of @p fine must be a multiple of this one. The local fine cells go through the cell-average
+     * rasterizer like particles, with keys that decode to the center of their coarse cell, so fine cells owned by
+     * other ranks reach their coarse cell through the usual exchange. Restriction of a rasterized grid stands in for
+     * rasterizing the particles again at the coarser resolution.
+     */
+    void restrictFrom(Mesh& fine)
+    {
+        if (fine.gridDim_ % gridDim_ != 0) { throw std::invalid_argument("Fine grid size is not a multiple"); }
+        int factor = fine.gridDim_ / gridDim_;
+        fine.copyGridToHost();
+
+        const auto&           box = fine.inbox_;
+        std::vector<KeyType>  keys;
+        std::vector<uint64_t> order(fine.velX_.size());
+        keys.reserve(order.size());
+
+        unsigned divisor = 1 + (1 << 21) / gridDim_;
+        for (int k = box.low[2]; k <= box.high[2]; k++)
+        {
+            for (int j = box.low[1]; j <= box.high[1]; j++)
+            {
+                for (int i = box.low[0]; i <= box.high[0]; i++)
+                {
+                    auto center = [divisor, factor](int c) { return (c / factor) * divisor + divisor / 2; };
+                    keys.push_back(cstone::iHilbert<KeyType>(center(i), center(j), center(k)));
+                }
+            }
+        }
+
+        // the rasterizer combines runs of consecutive records of the same cell, which SFC order maximizes
+        std::iota(order.begin(), order.end(), uint64_t(0));
+        std::sort(order.begin(), order.end(), [&keys](uint64_t a, uint64_t b) { return keys[a] < keys[b]; });
+        auto permuted = [&order](const std::vector<T>& v)
+        {
+            std::vector<T> out(order.size());
+            for (uint64_t p = 0; p < order.size(); p++)
+            {
+                out[p] = v[order[p]];
+            }
+            return out;
+        };
+        // a scalar field is carried in all three components, the coarse mesh only reads velX_ back
+        std::vector<T>       vx = permuted(fine.velX_);
+        std::vector<T>       vy = fine.scalarField_ ? vx : permuted(fine.velY_);
+        std::vector<T>       vz = fine.scalarField_ ? vx : permuted(fine.velZ_);
+        std::vector<KeyType> sortedKeys(keys.size());
+        for (uint64_t p = 0; p < order.size(); p++)
+        {
+            sortedKeys[p] = keys[order[p]];
+        }
+
+        std::vector<T> unused;
+        rasterize_particles_to_mesh_cell_avg(sortedKeys, unused, unused, unused, vx, vy, vz, 0);
+    }
+
+    template<class P>
+    void rasterize_particles_to_mesh(const std::vector<KeyType>& keys, const std::vector<P>& x, const std::vector<P>& y,
+                                     const std::vector<P>& z, const std::vector<P>& vx, const std::vector<P>& vy,
+                                     const std::vector<P>& vz, int powerDim)
     {
         // std::cout << "rank" << rank_ << " rasterize start " << powerDim << std::endl;
         // std::cout << "rank" << rank_ << " keys between " << *keys.begin() << " - " << keys.back() << std::endl;
         std::fill(send_count.begin(), send_count.end(), 0);
         std::fill(send_disp.begin(), send_disp.end(), 0);
         std::fill(recv_disp.begin(), recv_disp.end(), 0);
+        deferredParticles_.clear();
+
+        if (exchangeBudgetBytes_ > 0)
+        {
+            struct Record
+            {
+                uint32_t index;
+                T        distance, vx, vy, vz;
+            };
+
+            size_t cursor  = 0;
+            auto   produce = [&](std::vector<std::pair<int, Record>>& staging, size_t capacity)
+            {
+                for (; cursor < keys.size() && staging.size() < capacity; cursor++)
+                {
+                    auto crd    = calculateKeyIndices(keys[cursor], gridDim_);
+                    int  indexi = std::get<0>(crd);
+                    int  indexj = std::get<1>(crd);
+                    int  indexk = std::get<2>(crd);
+
+                    T distance = calculateDistance(x[cursor], y[cursor], z[cursor], indexi, indexj, indexk);
+                    int targetRank = calculateRankFromMeshCoord(indexi, indexj, indexk);
+                    if (targetRank == rank_)
+                    {
+                        assignVelocityByMeshCoord(indexi, indexj, indexk, distance, vx[cursor], vy[cursor], vz[cursor]);
+                        continue;
+                    }
+                    uint32_t targetIndex = calculateInboxIndexFromMeshCoord(indexi, indexj, indexk);
+                    staging.push_back({targetRank, Record{targetIndex, distance, vx[cursor], vy[cursor], vz[cursor]}});
+                }
+                return cursor < keys.size();
+            };
+            auto apply = [&](const Record* records, size_t count)
+            {
+                for (size_t i = 0; i < count; i++)
+                {
+                    const Record& rec = records[i];
+                    if (rec.distance < distance_[rec.index])
+                    {
+                        velX_[rec.index]     = rec.vx;
+                        velY_[rec.index]     = rec.vy;
+                        velZ_[rec.index]     = rec.vz;
+                        distance_[rec.index] = rec.distance;
+                    }
+                }
+            };
+            chunkedExchange<Record>(exchangeBudgetBytes_, produce, apply, sparseExchange_, MPI_COMM_WORLD);
+
+            extrapolateEmptyCellsFromNeighbors();
+            return;
+        }
+
+        auto depositParticle = [&](int particleIndex, int indexi, int indexj, int indexk)
+        {
+            double distance =
+                calculateDistance(x[particleIndex], y[particleIndex], z[particleIndex], indexi, indexj, indexk);
+            assignVelocityByMeshCoord(indexi, indexj, indexk, distance, vx[particleIndex], vy[particleIndex],
+                                      vz[particleIndex]);
+        };
 
         int particleIndex = 0;
         // iterate over keys vector
@@ -256,10 +522,12 @@ public:
             assert(indexj < gridDim_);
             assert(indexk < gridDim_);
 
-            double distance =
-                calculateDistance(x[particleIndex], y[particleIndex], z[particleIndex], indexi, indexj, indexk);
-            assignVelocityByMeshCoord(indexi, indexj, indexk, distance, vx[particleIndex], vy[particleIndex],
-                                      vz[particleIndex]);
+            if (overlapExchange_ && calculateRankFromMeshCoord(indexi, indexj, indexk) == rank_)
+            {
+                deferredParticles_.push_back(particleIndex++);
+                continue;
+            }
+            depositParticle(particleIndex, indexi, indexj, indexk);
             particleIndex++;
         }
 
@@ -267,7 +535,7 @@ public:
         // for (int i = 0; i < numRanks_; i++)
         //     std::cout << "rank = " << rank_ << " send_count = " << send_count[i] << std::endl;
 
-        MPI_Alltoall(send_count.data(), 1, MpiType<int>{}, recv_count.data(), 1, MpiType<int>{}, MPI_COMM_WORLD);
+        exchangeCounts(send_count, recv_count, sparseExchange_, MPI_COMM_WORLD);
 
         for (int i = 0; i < numRanks_; i++)
         {
@@ -303,29 +571,52 @@ public:
         recv_vy.resize(recv_disp[numRanks_]);
         recv_vz.resize(recv_disp[numRanks_]);
 
-        MPI_Alltoallv(send_index.data(), send_count.data(), send_disp.data(), MpiType<uint64_t>{}, recv_index.data(),
-                      recv_count.data(), recv_disp.data(), MpiType<uint64_t>{}, MPI_COMM_WORLD);
-        MPI_Alltoallv(send_distance.data(), send_count.data(), send_disp.data(), MpiType<T>{}, recv_distance.data(),
-                      recv_count.data(), recv_disp.data(), MpiType<T>{}, MPI_COMM_WORLD);
-        MPI_Alltoallv(send_vx.data(), send_count.data(), send_disp.data(), MpiType<T>{}, recv_vx.data(),
-                      recv_count.data(), recv_disp.data(), MpiType<T>{}, MPI_COMM_WORLD);
-        MPI_Alltoallv(send_vy.data(), send_count.data(), send_disp.data(), MpiType<T>{}, recv_vy.data(),
-                      recv_count.data(), recv_disp.data(), MpiType<T>{}, MPI_COMM_WORLD);
-        MPI_Alltoallv(send_vz.data(), send_count.data(), send_disp.data(), MpiType<T>{}, recv_vz.data(),
-                      recv_count.data(), recv_disp.data(), MpiType<T>{}, MPI_COMM_WORLD);
-        // std::cout << "rank = " << rank_ << " alltoallv done!" << std::endl;
+        auto applyReceived = [&](int first, int last)
+        {
+            for (int i = first; i < last; i++)
+            {
+                uint64_t index = recv_index[i];
+                if (recv_distance[i] < distance_[index])
+                {
+                    velX_[index]     = recv_vx[i];
+                    velY_[index]     = recv_vy[i];
+                    velZ_[index]     = recv_vz[i];
+                    distance_[index] = recv_distance[i];
+                }
+            }
+        };
 
-        for (int i = 0; i < recv_disp[numRanks_]; i++)
+        if (overlapExchange_)
         {
-            uint64_t index = recv_index[i];
-            if (recv_distance[i] < distance_[index])
+            PendingExchange exchange(send_count, send_disp, recv_count, recv_disp, MPI_COMM_WORLD);
+            exchange.postIndices(send_index, recv_index, compressIndexExchange_);
+            exchange.post(send_distance.data(), recv_distance.data());
+            exchange.post(send_vx.data(), recv_vx.data());
+            exchange.post(send_vy.data(), recv_vy.data());
+            exchange.post(send_vz.data(), recv_vz.data());
+
+            for (int p : deferredParticles_)
             {
-                velX_[index]     = recv_vx[i];
-                velY_[index]     = recv_vy[i];
-                velZ_[index]     = recv_vz[i];
-                distance_[index] = recv_distance[i];
+                auto crd = calculateKeyIndices(keys[p], gridDim_);
+                depositParticle(p, std::get<0>(crd), std::get<1>(crd), std::get<2>(crd));
             }
+            exchange.drain([&](int r) { applyReceived(recv_disp[r], recv_disp[r] + recv_count[r]); });
+        }
+        else
+        {
+            exchangeIndices(send_index, send_count, send_disp, recv_index, recv_count, recv_disp,
+                            compressIndexExchange_, sparseExchange_, MPI_COMM_WORLD);
+            exchangeValues(send_distance.data(), send_count, send_disp, recv_distance.data(), recv_count, recv_disp,
+                           sparseExchange_, MPI_COMM_WORLD);
+            exchangeValues(send_vx.data(), send_count, send_disp, recv_vx.data(), recv_count, recv_disp,
+                           sparseExchange_, MPI_COMM_WORLD);
+            exchangeValues(send_vy.data(), send_count, send_disp, recv_vy.data(), recv_count, recv_disp,
+                           sparseExchange_, MPI_COMM_WORLD);
+            exchangeValues(send_vz.data(), send_count, send_disp, recv_vz.data(), recv_count, recv_disp,
+                           sparseExchange_, MPI_COMM_WORLD);
+            applyReceived(0, recv_disp[numRanks_]);
         }
+        // std::cout << "rank = " << rank_ << " alltoallv done!" << std::endl;
 
         // clear the vectors
         for (int i = 0; i < numRanks_; i++)
@@ -341,16 +632,20 @@ public:
         extrapolateEmptyCellsFromNeighbors();
     }
 
-    void rasterize_particles_to_density(const std::vector<KeyType>& keys, const std::vector<T>& x,
-                                        const std::vector<T>& y, const std::vector<T>& z, int powerDim)
+    template<class P>
+    void rasterize_particles_to_density(const std::vector<KeyType>& keys, const std::vector<P>& x,
+                                        const std::vector<P>& y, const std::vector<P>& z, int powerDim)
     {
         // std::cout << "rank" << rank_ << " rasterize density start " << powerDim << std::endl;
         (void)x;
         (void)y;
         (void)z;
 
-        std::fill(massSum_.begin(), massSum_.end(), T(0));
-        std::fill(density_.begin(), density_.end(), T(0));
+        if (!accumulateBlocks_)
+        {
+            std::fill(massSum_.begin(), massSum_.end(), T(0));
+            std::fill(density_.begin(), density_.end(), T(0));
+        }
         std::fill(send_count_density.begin(), send_count_density.end(), 0);
         std::fill(send_disp_density.begin(), send_disp_density.end(), 0);
         std::fill(recv_disp_density.begin(), recv_disp_density.end(), 0);
@@ -360,6 +655,84 @@ public:
             vdataSenderDensity[i].send_index.clear();
             vdataSenderDensity[i].send_mass.clear();
         }
+        deferredParticles_.clear();
+
+        if (subgridReshape_)
+        {
+            Subgrids sg = beginSubgrids({massSum_.data()});
+            for (KeyType key : keys)
+            {
+                auto [i, j, k] = calculateKeyIndices(key, gridDim_);
+                addSubgridCells(sg, {i, j, k}, {i, j, k});
+            }
+            allocateSubgrids(sg);
+            for (KeyType key : keys)
+            {
+                auto [i, j, k] = calculateKeyIndices(key, gridDim_);
+                depositSubgrid<1>(sg, i, j, k, {T(particleMass_)});
+            }
+            reshapeSubgrids(sg);
+            finalizeDensityFromMass();
+            return;
+        }
+
+        if (exchangeBudgetBytes_ > 0)
+        {
+            struct Record
+            {
+                uint32_t index;
+                T        mass;
+            };
+
+            // consecutive particles for the same remote cell are merged into the last staged record
+            size_t cursor  = 0;
+            auto   produce = [&](std::vector<std::pair<int, Record>>& staging, size_t capacity)
+            {
+                for (; cursor < keys.size() && staging.size() < capacity; cursor++)
+                {
+                    auto     crd         = calculateKeyIndices(keys[cursor], gridDim_);
+                    int      indexi      = std::get<0>(crd);
+                    int      indexj      = std::get<1>(crd);
+                    int      indexk      = std::get<2>(crd);
+                    int      targetRank  = calculateRankFromMeshCoord(indexi, indexj, indexk);
+                    uint32_t targetIndex = calculateInboxIndexFromMeshCoord(indexi, indexj, indexk);
+                    if (targetRank == rank_) { massSum_[targetIndex] += particleMass_; }
+                    else if (!staging.empty() && staging.back().first == targetRank &&
+                             staging.back().second.index == targetIndex)
+                    {
+                        staging.back().second.mass += particleMass_;
+                    }
+                    else { staging.push_back({targetRank, Record{targetIndex, particleMass_}}); }
+                }
+                return cursor < keys.size();
+            };
+            auto apply = [&](const Record* records, size_t count)
+            {
+                for (size_t i = 0; i < count; i++)
+                {
+                    massSum_[records[i].index] += records[i].mass;
+                }
+            };
+            chunkedExchange<Record>(exchangeBudgetBytes_, produce, apply, sparseExchange_, MPI_COMM_WORLD);
+
+            finalizeDensityFromMass();
+            return;
+        }
+
+        // Particles are in SFC order, so consecutive particles mostly land in the same cell. Remote contributions
+        // are combined over such runs and shipped as one mass sum per run instead of one record per particle.
+        int      runRank  = -1;
+        uint32_t runIndex = 0;
+        T        runMass  = 0;
+
+        auto flushRun = [&]()
+        {
+            if (runRank < 0) return;
+            send_count_density[runRank]++;
+            vdataSenderDensity[runRank].send_index.push_back(runIndex);
+            vdataSenderDensity[runRank].send_mass.push_back(runMass);
+            runRank = -1;
+        };
 
         for (auto it = keys.begin(); it != keys.end(); ++it)
         {
@@ -372,11 +745,28 @@ public:
             assert(indexj < gridDim_);
             assert(indexk < gridDim_);
 
-            assignDensityByMeshCoord(indexi, indexj, indexk, particleMass_);
+            int      targetRank  = calculateRankFromMeshCoord(indexi, indexj, indexk);
+            uint32_t targetIndex = calculateInboxIndexFromMeshCoord(indexi, indexj, indexk);
+
+            if (targetRank == rank_)
+            {
+                if (overlapExchange_) { deferredParticles_.push_back(it - keys.begin()); }
+                else { massSum_[targetIndex] += particleMass_; }
+                continue;
+            }
+
+            if (targetRank != runRank || targetIndex != runIndex)
+            {
+                flushRun();
+                runRank  = targetRank;
+                runIndex = targetIndex;
+                runMass  = 0;
+            }
+            runMass += particleMass_;
         }
+        flushRun();
 
-        MPI_Alltoall(send_count_density.data(), 1, MpiType<int>{}, recv_count_density.data(), 1, MpiType<int>{},
-                     MPI_COMM_WORLD);
+        exchangeCounts(send_count_density, recv_count_density, sparseExchange_, MPI_COMM_WORLD);
 
         for (int i = 0; i < numRanks_; i++)
         {
@@ -398,16 +788,38 @@ public:
 
         recv_index_density.resize(recv_disp_density[numRanks_]);
         recv_mass_density.resize(recv_disp_density[numRanks_]);
-        MPI_Alltoallv(send_index_density.data(), send_count_density.data(), send_disp_density.data(),
-                      MpiType<uint64_t>{}, recv_index_density.data(), recv_count_density.data(),
-                      recv_disp_density.data(), MpiType<uint64_t>{}, MPI_COMM_WORLD);
-        MPI_Alltoallv(send_mass_density.data(), send_count_density.data(), send_disp_density.data(), MpiType<T>{},
-                      recv_mass_density.data(), recv_count_density.data(), recv_disp_density.data(), MpiType<T>{},
-                      MPI_COMM_WORLD);
+        auto applyReceived = [&](int first, int last)
+        {
+            for (int i = first; i < last; i++)
+            {
+                massSum_[recv_index_density[i]] += recv_mass_density[i];
+            }
+        };
 
-        for (int i = 0; i < recv_disp_density[numRanks_]; i++)
+        if (overlapExchange_)
         {
-            massSum_[recv_index_density[i]] += recv_mass_density[i];
+            PendingExchange exchange(send_count_density, send_disp_density, recv_count_density, recv_disp_density,
+                                     MPI_COMM_WORLD);
+            exchange.postIndices(send_index_density, recv_index_density, compressIndexExchange_);
+            exchange.post(send_mass_density.data(), recv_mass_density.data());
+
+            for (int p : deferredParticles_)
+            {
+                auto crd = calculateKeyIndices(keys[p], gridDim_);
+                massSum_[calculateInboxIndexFromMeshCoord(std::get<0>(crd), std::get<1>(crd), std::get<2>(crd))] +=
+                    particleMass_;
+            }
+            exchange.drain([&](int r)
+                           { applyReceived(recv_disp_density[r], recv_disp_density[r] + recv_count_density[r]); });
+        }
+        else
+        {
+            exchangeIndices(send_index_density, send_count_density, send_disp_density, recv_index_density,
+                            recv_count_density, recv_disp_density, compressIndexExchange_, sparseExchange_,
+                            MPI_COMM_WORLD);
+            exchangeValues(send_mass_density.data(), send_count_density, send_disp_density, recv_mass_density.data(),
+                           recv_count_density, recv_disp_density, sparseExchange_, MPI_COMM_WORLD);
+            applyReceived(0, recv_disp_density[numRanks_]);
         }
         finalizeDensityFromMass();
 
@@ -419,21 +831,23 @@ public:
     }
 
     // SPH interpolation rasterization function
-    void rasterize_particles_to_mesh_sph(const std::vector<KeyType>& keys, const std::vector<T>& x,
-                                         const std::vector<T>& y, const std::vector<T>& z, const std::vector<T>& vx,
-                                         const std::vector<T>& vy, const std::vector<T>& vz, const std::vector<T>& h,
+    template<class P>
+    void rasterize_particles_to_mesh_sph(const std::vector<KeyType>& keys, const std::vector<P>& x,
+                                         const std::vector<P>& y, const std::vector<P>& z, const std::vector<P>& vx,
+                                         const std::vector<P>& vy, const std::vector<P>& vz, const std::vector<P>& h,
                                          int powerDim)
     {
         // std::cout << "rank" << rank_ << " rasterize start (SPH) " << powerDim << std::endl;
         // std::cout << "rank" << rank_ << " keys between " << *keys.begin() << " - " << keys.back() << std::endl;
 
         // Reset SPH accumulation arrays
-        uint64_t inboxSize = static_cast<uint64_t>(inbox_.size[0]) * static_cast<uint64_t>(inbox_.size[1]) *
-                             static_cast<uint64_t>(inbox_.size[2]);
-        std::fill(weightSum_.begin(), weightSum_.end(), 0.0);
-        std::fill(weightedVelX_.begin(), weightedVelX_.end(), 0.0);
-        std::fill(weightedVelY_.begin(), weightedVelY_.end(), 0.0);
-        std::fill(weightedVelZ_.begin(), weightedVelZ_.end(), 0.0);
+        if (!accumulateBlocks_)
+        {
+            std::fill(weightSum_.begin(), weightSum_.end(), 0.0);
+            std::fill(weightedVelX_.begin(), weightedVelX_.end(), 0.0);
+            std::fill(weightedVelY_.begin(), weightedVelY_.end(), 0.0);
+            std::fill(weightedVelZ_.begin(), weightedVelZ_.end(), 0.0);
+        }
         std::fill(send_count.begin(), send_count.end(), 0);
 
         // Clear SPH sender data
@@ -447,13 +861,35 @@ public:
         }
         // Aggregate remote SPH contributions by target rank + target local cell
         // before MPI exchange to avoid per-particle-cell traffic explosion.
-        std::vector<std::unordered_map<uint64_t, std::array<T, 4>>> remoteCellAgg(numRanks_);
+        std::vector<std::unordered_map<uint32_t, std::array<T, 4>>> remoteCellAgg(numRanks_);
 
         T deltaMesh = (Lmax_ - Lmin_) / gridDim_;
 
-        int particleIndex = 0;
-        // iterate over keys vector
-        for (auto it = keys.begin(); it != keys.end(); ++it)
+        deferredParticles_.clear();
+
+        // with subgridReshape_, stencils are deposited into one box per remote inbox they reach
+        Subgrids sg;
+        if (subgridReshape_)
+        {
+            sg = beginSubgrids({weightSum_.data(), weightedVelX_.data(), weightedVelY_.data(), weightedVelZ_.data()});
+            for (size_t p = 0; p < keys.size(); p++)
+            {
+                // same clamped cell range as the stencil loop below
+                T                  searchRadius = 2.0 * std::min(T(h[p]), deltaMesh);
+                std::array<T, 3>   pos{T(x[p]), T(y[p]), T(z[p])};
+                std::array<int, 3> low, high;
+                for (int d = 0; d < 3; d++)
+                {
+                    low[d]  = std::max(0, static_cast<int>((pos[d] - searchRadius - Lmin_) / deltaMesh));
+                    high[d] = std::min(gridDim_, static_cast<int>((pos[d] + searchRadius - Lmin_) / deltaMesh) + 1) - 1;
+                }
+                if (low[0] <= high[0] && low[1] <= high[1] && low[2] <= high[2]) { addSubgridCells(sg, low, high); }
+            }
+            allocateSubgrids(sg);
+        }
+
+        // deposits one particle's kernel stencil, returns false if deferred because the stencil is purely local
+        auto depositParticle = [&](int particleIndex, bool deferLocal) -> bool
         {
             T px = x[particleIndex];
             T py = y[particleIndex];
@@ -489,6 +925,13 @@ public:
             minK = std::max(0, minK);
             maxK = std::min(gridDim_, maxK);
 
+            // stencils entirely inside the local inbox can wait until the remote records are in flight
+            if (deferLocal && calculateRankFromMeshCoord(minI, minJ, minK) == rank_ &&
+                calculateRankFromMeshCoord(maxI - 1, maxJ - 1, maxK - 1) == rank_)
+            {
+                return false;
+            }
+
             // Iterate over potential cells
             for (int i = minI; i < maxI; i++)
             {
@@ -519,8 +962,15 @@ public:
                                 T weightedVx = pvx * weight;
                                 T weightedVy = pvy * weight;
                                 T weightedVz = pvz * weight;
+
+                                if (subgridReshape_)
+                                {
+                                    depositSubgrid<4>(sg, i, j, k, {weight, weightedVx, weightedVy, weightedVz});
+                                    continue;
+                                }
+
                                 int      targetRank  = calculateRankFromMeshCoord(i, j, k);
-                                uint64_t targetIndex = calculateInboxIndexFromMeshCoord(i, j, k);
+                                uint32_t targetIndex = calculateInboxIndexFromMeshCoord(i, j, k);
 
                                 if (targetRank == rank_)
                                 {
@@ -543,7 +993,20 @@ public:
                 }
             }
 
-            particleIndex++;
+            return true;
+        };
+
+        bool deferLocal = overlapExchange_ && !subgridReshape_;
+        for (size_t particleIndex = 0; particleIndex < keys.size(); particleIndex++)
+        {
+            if (!depositParticle(particleIndex, deferLocal)) { deferredParticles_.push_back(particleIndex); }
+        }
+
+        if (subgridReshape_)
+        {
+            reshapeSubgrids(sg);
+            normalizeSphVelocities();
+            return;
         }
 
         // Materialize aggregated remote entries into existing sender buffers.
@@ -575,7 +1038,7 @@ public:
         //     std::cout << "rank = " << rank_ << " send_count = " << send_count[i] << std::endl;
 
         // MPI communication for SPH data
-        MPI_Alltoall(send_count.data(), 1, MpiType<int>{}, recv_count.data(), 1, MpiType<int>{}, MPI_COMM_WORLD);
+        exchangeCounts(send_count, recv_count, sparseExchange_, MPI_COMM_WORLD);
 
         for (int i = 0; i < numRanks_; i++)
         {
@@ -612,27 +1075,49 @@ public:
         recv_weighted_vy.resize(recv_disp[numRanks_]);
         recv_weighted_vz.resize(recv_disp[numRanks_]);
 
-        MPI_Alltoallv(send_index_sph.data(), send_count.data(), send_disp.data(), MpiType<uint64_t>{}, recv_index_sph.data(),
-                      recv_count.data(), recv_disp.data(), MpiType<uint64_t>{}, MPI_COMM_WORLD);
-        MPI_Alltoallv(send_weight.data(), send_count.data(), send_disp.data(), MpiType<T>{}, recv_weight.data(),
-                      recv_count.data(), recv_disp.data(), MpiType<T>{}, MPI_COMM_WORLD);
-        MPI_Alltoallv(send_weighted_vx.data(), send_count.data(), send_disp.data(), MpiType<T>{}, recv_weighted_vx.data(),
-                      recv_count.data(), recv_disp.data(), MpiType<T>{}, MPI_COMM_WORLD);
-        MPI_Alltoallv(send_weighted_vy.data(), send_count.data(), send_disp.data(), MpiType<T>{}, recv_weighted_vy.data(),
-                      recv_count.data(), recv_disp.data(), MpiType<T>{}, MPI_COMM_WORLD);
-        MPI_Alltoallv(send_weighted_vz.data(), send_count.data(), send_disp.data(), MpiType<T>{}, recv_weighted_vz.data(),
-                      recv_count.data(), recv_disp.data(), MpiType<T>{}, MPI_COMM_WORLD);
-        // std::cout << "rank = " << rank_ << " alltoallv done!" << std::endl;
-
         // Accumulate received contributions
-        for (int i = 0; i < recv_disp[numRanks_]; i++)
+        auto applyReceived = [&](int first, int last)
         {
-            uint64_t index = recv_index_sph[i];
-            weightSum_[index] += recv_weight[i];
-            weightedVelX_[index] += recv_weighted_vx[i];
-            weightedVelY_[index] += recv_weighted_vy[i];
-            weightedVelZ_[index] += recv_weighted_vz[i];
+            for (int i = first; i < last; i++)
+            {
+                uint64_t index = recv_index_sph[i];
+                weightSum_[index] += recv_weight[i];
+                weightedVelX_[index] += recv_weighted_vx[i];
+                weightedVelY_[index] += recv_weighted_vy[i];
+                weightedVelZ_[index] += recv_weighted_vz[i];
+            }
+        };
+
+        if (overlapExchange_)
+        {
+            PendingExchange exchange(send_count, send_disp, recv_count, recv_disp, MPI_COMM_WORLD);
+            exchange.postIndices(send_index_sph, recv_index_sph, compressIndexExchange_);
+            exchange.post(send_weight.data(), recv_weight.data());
+            exchange.post(send_weighted_vx.data(), recv_weighted_vx.data());
+            exchange.post(send_weighted_vy.data(), recv_weighted_vy.data());
+            exchange.post(send_weighted_vz.data(), recv_weighted_vz.data());
+
+            for (int p : deferredParticles_)
+            {
+                depositParticle(p, false);
+            }
+            exchange.drain([&](int r) { applyReceived(recv_disp[r], recv_disp[r] + recv_count[r]); });
+        }
+        else
+        {
+            exchangeIndices(send_index_sph, send_count, send_disp, recv_index_sph, recv_count, recv_disp,
+                            compressIndexExchange_, sparseExchange_, MPI_COMM_WORLD);
+            exchangeValues(send_weight.data(), send_count, send_disp, recv_weight.data(), recv_count, recv_disp,
+                           sparseExchange_, MPI_COMM_WORLD);
+            exchangeValues(send_weighted_vx.data(), send_count, send_disp, recv_weighted_vx.data(), recv_count,
+                           recv_disp, sparseExchange_, MPI_COMM_WORLD);
+            exchangeValues(send_weighted_vy.data(), send_count, send_disp, recv_weighted_vy.data(), recv_count,
+                           recv_disp, sparseExchange_, MPI_COMM_WORLD);
+            exchangeValues(send_weighted_vz.data(), send_count, send_disp, recv_weighted_vz.data(), recv_count,
+                           recv_disp, sparseExchange_, MPI_COMM_WORLD);
+            applyReceived(0, recv_disp[numRanks_]);
         }
+        // std::cout << "rank = " << rank_ << " alltoallv done!" << std::endl;
 
         // Clear the vectors
         for (int i = 0; i < numRanks_; i++)
@@ -644,7 +1129,17 @@ public:
             vdataSenderSPH[i].send_weighted_vz.clear();
         }
 
-        // Normalize velocities by dividing by weight sum
+        normalizeSphVelocities();
+
+        // extrapolate mesh cells which doesn't have any particles assigned
+        // extrapolateEmptyCellsFromNeighbors();
+    }
+
+    // Normalize velocities by dividing by weight sum
+    void normalizeSphVelocities()
+    {
+        if (accumulateBlocks_) return;
+        uint64_t inboxSize = weightSum_.size();
 #pragma omp parallel for
         for (uint64_t i = 0; i < inboxSize; i++)
         {
@@ -655,15 +1150,12 @@ public:
                 velZ_[i] = weightedVelZ_[i] / weightSum_[i];
             }
         }
-
-        // extrapolate mesh cells which doesn't have any particles assigned
-        // extrapolateEmptyCellsFromNeighbors();
     }
 
     void assignVelocityByMeshCoordSPH(int meshx, int meshy, int meshz, T weight, T weightedVx, T weightedVy, T weightedVz)
     {
         int      targetRank  = calculateRankFromMeshCoord(meshx, meshy, meshz);
-        uint64_t targetIndex = calculateInboxIndexFromMeshCoord(meshx, meshy, meshz);
+        uint32_t targetIndex = calculateInboxIndexFromMeshCoord(meshx, meshy, meshz);
 
         if (targetRank == rank_)
         {
@@ -696,7 +1188,7 @@ public:
     void assignVelocityByMeshCoord(int meshx, int meshy, int meshz, T distance, T velox, T veloy, T veloz)
     {
         int      targetRank  = calculateRankFromMeshCoord(meshx, meshy, meshz);
-        uint64_t targetIndex = calculateInboxIndexFromMeshCoord(meshx, meshy, meshz);
+        uint32_t targetIndex = calculateInboxIndexFromMeshCoord(meshx, meshy, meshz);
 
         if (targetRank == rank_)
         {
@@ -730,7 +1222,7 @@ public:
     void assignDensityByMeshCoord(int meshx, int meshy, int meshz, T mass)
     {
         int      targetRank  = calculateRankFromMeshCoord(meshx, meshy, meshz);
-        uint64_t targetIndex = calculateInboxIndexFromMeshCoord(meshx, meshy, meshz);
+        uint32_t targetIndex = calculateInboxIndexFromMeshCoord(meshx, meshy, meshz);
 
         if (targetRank == rank_)
         {
@@ -746,6 +1238,7 @@ public:
 
     void finalizeDensityFromMass()
     {
+        if (accumulateBlocks_) return;
         T boxSize = (Lmax_ - Lmin_);
         T dx      = boxSize / static_cast<T>(gridDim_);
         T cellVol = dx * dx * dx;
@@ -762,65 +1255,75 @@ public:
 
     void extrapolateEmptyCellsFromNeighbors()
     {
+        if (accumulateBlocks_) return;
         // std::cout << "rank = " << rank_ << " extrapolate cells" << std::endl;
+        const int sx = inbox_.size[0];
+        const int sy = inbox_.size[1];
+        const int sz = inbox_.size[2];
 
-        // Read from immutable snapshots so parallel threads don't see each
-        // other's writes when sampling neighbors.
-        const std::vector<T> srcVelX = velX_;
-        const std::vector<T> srcVelY = velY_;
-        const std::vector<T> srcVelZ = velZ_;
+        // Gather the empty cells first so that the work below scales with their number instead of the inbox size
+        std::vector<uint64_t> emptyCells;
+        for (uint64_t index = 0; index < distance_.size(); index++)
+        {
+            if (distance_[index] == std::numeric_limits<T>::infinity()) { emptyCells.push_back(index); }
+        }
+        if (emptyCells.empty()) return;
 
-#pragma omp parallel for collapse(3)
-        for (int i = 0; i < inbox_.size[2]; i++)
+        // New values go into a side buffer and are scattered afterwards, so neighbors are always sampled from the
+        // state before extrapolation without snapshotting the full velocity fields.
+        std::vector<T>   fillVelX(emptyCells.size());
+        std::vector<T>   fillVelY(emptyCells.size());
+        std::vector<T>   fillVelZ(emptyCells.size());
+        std::vector<int> fillCount(emptyCells.size());
+
+#pragma omp parallel for schedule(static)
+        for (size_t e = 0; e < emptyCells.size(); e++)
         {
-            for (int j = 0; j < inbox_.size[1]; j++)
+            uint64_t index = emptyCells[e];
+            int      k     = index % sx;
+            int      j     = (index / sx) % sy;
+            int      i     = index / (uint64_t(sx) * sy);
+
+            // iterate over the neighbors and average the velocities of the neighbors which have a distance assigned
+            T   velXSum = 0;
+            T   velYSum = 0;
+            T   velZSum = 0;
+            int count   = 0;
+            for (int ni = std::max(i - 1, 0); ni <= std::min(i + 1, sz - 1); ni++)
             {
-                for (int k = 0; k < inbox_.size[0]; k++)
+                for (int nj = std::max(j - 1, 0); nj <= std::min(j + 1, sy - 1); nj++)
                 {
-                    uint64_t index = k + j * inbox_.size[0] + i * inbox_.size[0] * inbox_.size[1];
-                    if (distance_[index] == std::numeric_limits<T>::infinity())
+                    for (int nk = std::max(k - 1, 0); nk <= std::min(k + 1, sx - 1); nk++)
                     {
-                        // iterate over the neighbors and average the velocities of the neighbors which have a distance
-                        // assigned
-                        T   velXSum = 0;
-                        T   velYSum = 0;
-                        T   velZSum = 0;
-                        int count   = 0;
-                        for (int ni = i - 1; ni <= i + 1; ni++)
-                        {
-                            if (ni < 0 || ni >= inbox_.size[2]) continue;
-                            for (int nj = j - 1; nj <= j + 1; nj++)
-                            {
-                                if (nj < 0 || nj >= inbox_.size[1]) continue;
-                                for (int nk = k - 1; nk <= k + 1; nk++)
-                                {
-                                    if (nk < 0 || nk >= inbox_.size[0])
-                                        continue;
-                                    else
-                                    {
-                                        uint64_t neighborIndex = (ni * inbox_.size[1] + nj) * inbox_.size[0] + nk;
-                                        assert(neighborIndex < inbox_.size[0] * inbox_.size[1] * inbox_.size[2]);
-                                        if (distance_[neighborIndex] != std::numeric_limits<T>::infinity())
-                                        {
-                                            velXSum += srcVelX[neighborIndex];
-                                            velYSum += srcVelY[neighborIndex];
-                                            velZSum += srcVelZ[neighborIndex];
-                                            count++;
-                                        }
-                                    }
-                                }
-                            }
-                        }
-
-                        if (count > 0)
+                        uint64_t neighborIndex = (uint64_t(ni) * sy + nj) * sx + nk;
+                        if (distance_[neighborIndex] != std::numeric_limits<T>::infinity())
                         {
-                            velX_[index] = velXSum / count;
-                            velY_[index] = velYSum / count;
-                            velZ_[index] = velZSum / count;
+                            velXSum += velX_[neighborIndex];
+                            velYSum += velY_[neighborIndex];
+                            velZSum += velZ_[neighborIndex];
+                            count++;
                         }
                     }
                 }
             }
+
+            fillCount[e] = count;
+            if (count > 0)
+            {
+                fillVelX[e] = velXSum / count;
+                fillVelY[e] = velYSum / count;
+                fillVelZ[e] = velZSum / count;
+            }
+        }
+
+#pragma omp parallel for schedule(static)
+        for (size_t e = 0; e < emptyCells.size(); e++)
+        {
+            if (fillCount[e] == 0) continue;
+            uint64_t index = emptyCells[e];
+            velX_[index]   = fillVelX[e];
+            velY_[index]   = fillVelY[e];
+            velZ_[index]   = fillVelZ[e];
         }
     }
 
@@ -829,19 +1332,43 @@ public:
         // returns the velocity field square
         calculate_fft();
 
+        // normalization is linear in the binned power, the solenoidal spectrum is the remainder of the total
+        bool split = helmholtzSplit_ && !scalarField_;
+        if (split)
+        {
+            perform_spherical_averaging(compressive_.data(), false);
+            compressiveSpectrum_ = power_spectrum_;
+        }
+        auto splitSolenoidal = [this, split]()
+        {
+            if (!split || rank_ != 0) { return; }
+            solenoidalSpectrum_.resize(numShells_);
+            for (int i = 0; i < numShells_; i++)
+            {
+                solenoidalSpectrum_[i] = power_spectrum_[i] - compressiveSpectrum_[i];
+            }
+        };
+
 #ifdef USE_CUDA
         // GPU path: after FFTW, d_velX_/Y_/Z_ hold per-component power spectrum.
         // Use GPU spherical averaging when GPU rasterization data is active.
-        if (gpuDataValid_ && d_velX_ && d_velY_ && d_velZ_)
+        if (!scalarField_ && cylinderAxis_ < 0 && shellEdges_.empty() && gpuDataValid_ && d_velX_ && d_velY_ &&
+            d_velZ_)
         {
             perform_spherical_averaging_gpu();
             gpuDataValid_ = false;
+            splitSolenoidal();
             // std::cout << "done." << std::endl;
             return;
         }
 #endif
 
-        // CPU path
+        // CPU path, a scalar field's power is binned in place
+        if (scalarField_)
+        {
+            perform_spherical_averaging(velX_.data());
+            return;
+        }
         std::vector<T> freqVelo(velX_.size());
 
 #pragma omp parallel for
@@ -851,9 +1378,26 @@ public:
         }
 
         perform_spherical_averaging(freqVelo.data());
+        splitSolenoidal();
         // std::cout << "done." << std::endl;
     }
 
+    //! @brief make velX_/velY_/velZ_ on the host current if the grid was rasterized on the GPU
+    void copyGridToHost()
+    {
+#ifdef USE_CUDA
+        if (gpuDataValid_ && d_velX_ && d_velY_ && d_velZ_)
+        {
+            cudaError_t err = cudaMemcpy(velX_.data(), d_velX_, velX_.size() * sizeof(T), cudaMemcpyDeviceToHost);
+            if (err != cudaSuccess) { std::cerr << "CUDA Error copying velX to host: " << cudaGetErrorString(err) << std::endl; std::exit(EXIT_FAILURE); }
+            err = cudaMemcpy(velY_.data(), d_velY_, velY_.size() * sizeof(T), cudaMemcpyDeviceToHost);
+            if (err != cudaSuccess) { std::cerr << "CUDA Error copying velY to host: " << cudaGetErrorString(err) << std::endl; std::exit(EXIT_FAILURE); }
+            err = cudaMemcpy(velZ_.data(), d_velZ_, velZ_.size() * sizeof(T), cudaMemcpyDeviceToHost);
+            if (err != cudaSuccess) { std::cerr << "CUDA Error copying velZ to host: " << cudaGetErrorString(err) << std::endl; std::exit(EXIT_FAILURE); }
+        }
+#endif
+    }
+
     void calculate_fft()
     {
         // std::cout << "rank = " << rank_ << " fft calculation started." << std::endl;
@@ -886,11 +1430,16 @@ public:
             }
         };
 
-        // Use FFTW backend for CPU cases
-        heffte::plan_options options = heffte::default_options<heffte::backend::fftw>();
-        options.use_pencils          = usePencils_;
-
-        heffte::fft3d<heffte::backend::fftw> fft(inbox_, outbox, MPI_COMM_WORLD, options);
+        // Use FFTW backend for CPU cases. The plan only depends on the boxes and options, it is reused for later steps
+        if (!fftPlan_)
+        {
+            heffte::plan_options options = heffte::default_options<heffte::backend::fftw>();
+            options.use_pencils          = usePencils_;
+            options.use_reorder          = fftReorder_;
+            options.algorithm            = fftAlgorithm_;
+            fftPlan_ = std::make_shared<heffte::fft3d<heffte::backend::fftw>>(inbox_, outbox, MPI_COMM_WORLD, options);
+        }
+        auto& fft = *fftPlan_;
 
         std::cout << "rank=" << rank_
                   << " heFFTe outbox=" << fft.size_outbox()
@@ -899,25 +1448,22 @@ public:
 
         std::vector<std::complex<T>> output(fft.size_outbox());
 
-    #ifdef USE_CUDA
-        // If GPU rasterization is active, copy velocity fields to host and run FFTW on CPU.
-        if (gpuDataValid_ && d_velX_ && d_velY_ && d_velZ_)
+        // FFTW runs on the host, GPU rasterization results are copied over first
+        copyGridToHost();
+
+        reportHostRealStats("cpu_pre_fft_velX", velX_.data(), velX_.size());
+        if (!scalarField_)
         {
-            cudaError_t err = cudaMemcpy(velX_.data(), d_velX_, velX_.size() * sizeof(T), cudaMemcpyDeviceToHost);
-            if (err != cudaSuccess) { std::cerr << "CUDA Error copying velX to host for FFTW: " << cudaGetErrorString(err) << std::endl; std::exit(EXIT_FAILURE); }
-            err = cudaMemcpy(velY_.data(), d_velY_, velY_.size() * sizeof(T), cudaMemcpyDeviceToHost);
-            if (err != cudaSuccess) { std::cerr << "CUDA Error copying velY to host for FFTW: " << cudaGetErrorString(err) << std::endl; std::exit(EXIT_FAILURE); }
-            err = cudaMemcpy(velZ_.data(), d_velZ_, velZ_.size() * sizeof(T), cudaMemcpyDeviceToHost);
-            if (err != cudaSuccess) { std::cerr << "CUDA Error copying velZ to host for FFTW: " << cudaGetErrorString(err) << std::endl; std::exit(EXIT_FAILURE); }
+            reportHostRealStats("cpu_pre_fft_velY", velY_.data(), velY_.size());
+            reportHostRealStats("cpu_pre_fft_velZ", velZ_.data(), velZ_.size());
         }
-    #endif
 
-        reportHostRealStats("cpu_pre_fft_velX", velX_.data(), velX_.size());
-        reportHostRealStats("cpu_pre_fft_velY", velY_.data(), velY_.size());
-        reportHostRealStats("cpu_pre_fft_velZ", velZ_.data(), velZ_.size());
+        // the Helmholtz split needs all three complex components of a mode at once
+        std::vector<std::complex<T>> spectralX, spectralY;
 
         // divide the fft.forward results by the mesh size as the first step of normalization
         fft.forward(velX_.data(), output.data(), heffte::scale::none);
+        if (helmholtzSplit_) { spectralX = output; }
 
 #pragma omp parallel for
         for (uint64_t i = 0; i < velX_.size(); i++)
@@ -927,7 +1473,11 @@ public:
         }
         reportHostRealStats("cpu_post_fft_power_velX", velX_.data(), velX_.size());
 
+        // a scalar field has no further components to transform
+        if (scalarField_) { return; }
+
         fft.forward(velY_.data(), output.data(), heffte::scale::none);
+        if (helmholtzSplit_) { spectralY = output; }
 
 #pragma omp parallel for
         for (uint64_t i = 0; i < velY_.size(); i++)
@@ -938,6 +1488,7 @@ public:
         reportHostRealStats("cpu_post_fft_power_velY", velY_.data(), velY_.size());
 
         fft.forward(velZ_.data(), output.data(), heffte::scale::none);
+        if (helmholtzSplit_) { compressivePower(spectralX, spectralY, output, meshSize); }
 
 #pragma omp parallel for
         for (uint64_t i = 0; i < velZ_.size(); i++)
@@ -961,6 +1512,41 @@ public:
 #endif
     }
 
+    /*! @brief power of the longitudinal part |k.v|^2 / |k|^2 of each local mode, normalized like the component powers
+     *
+     * The outbox equals the inbox, mode (i, j, k) of the local box has the wave vector of global cell (i, j, k). The
+     * k = 0 mode has no direction and counts as solenoidal.
+     */
+    void compressivePower(const std::vector<std::complex<T>>& fx, const std::vector<std::complex<T>>& fy,
+                          const std::vector<std::complex<T>>& fz, uint64_t meshSize)
+    {
+        std::vector<T> k_values(gridDim_);
+        fftfreq(k_values, gridDim_, 1.0 / gridDim_);
+        compressive_.resize(fz.size());
+
+        const int sx = inbox_.size[0];
+        const int sy = inbox_.size[1];
+        T         norm = T(1) / (T(meshSize) * T(meshSize));
+#pragma omp parallel for collapse(3)
+        for (int k = 0; k < inbox_.size[2]; k++)
+        {
+            for (int j = 0; j < sy; j++)
+            {
+                for (int i = 0; i < sx; i++)
+                {
+                    uint64_t idx = i + uint64_t(j) * sx + uint64_t(k) * sx * sy;
+                    T        kx  = k_values[i + inbox_.low[0]];
+                    T        ky  = k_values[j + inbox_.low[1]];
+                    T        kz  = k_values[k + inbox_.low[2]];
+                    T        k2  = kx * kx + ky * ky + kz * kz;
+
+                    std::complex<T> kv = kx * fx[idx] + ky * fy[idx] + kz * fz[idx];
+                    compressive_[idx]  = k2 > 0 ? std::norm(kv) / k2 * norm : T(0);
+                }
+            }
+        }
+    }
+
     // Implemented following numpy.fft.fftfreq
     void fftfreq(std::vector<T>& freq, int n, double dt)
     {
@@ -1087,70 +1673,98 @@ public:
         MPI_Reduce(ps_rad.data(), power_spectrum_.data(), numShells_, MpiType<T>{}, MPI_SUM, 0, MPI_COMM_WORLD);
         MPI_Reduce(count.data(), counts.data(), numShells_, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
 
-        // Normalize the power spectrum
-        if (rank_ == 0)
-        {
-            T sum_ps_radial = std::accumulate(power_spectrum_.begin(), power_spectrum_.end(), 0.0);
-            std::cout << "sum_ps_radial: " << sum_ps_radial << std::endl;
+        normalizeShells(counts, k_1d);
 
-            int minBinCount = 64;
-            if (const char* env = std::getenv("PS_MIN_BIN_COUNT")) minBinCount = std::max(1, std::atoi(env));
+        // Free temporary device memory
+        cudaFree(d_k_values);
+        cudaFree(d_k_1d);
+        cudaFree(d_ps_rad);
+        cudaFree(d_count);
+        cudaFree(d_inboxSize);
+        cudaFree(d_inboxLow);
+    }
+#endif
+
+    /*! @brief turn the reduced shell power sums on rank 0 into the normalized spectrum
+     *
+     * Shells with fewer than PS_MIN_BIN_COUNT (default 64) modes are merged with the following ones. The merged bin's
+     * mean power is scaled by 4 pi <k^2> over its modes. shellCounts_, shellPower_ and shellK_ keep the mode count,
+     * the unnormalized power sum and the mean |k| of the (merged) bin of each shell. Integer shells take k^2 from
+     * @p k_1d, custom shells pass the reduced sums of k^2 over their modes in @p k2Sums. The mean |k| comes from the
+     * reduced sums of |k| in @p kSums, without them the shell centers of @p k_1d stand in.
+     */
+    void normalizeShells(const std::vector<int>& counts, const std::vector<T>& k_1d, const std::vector<T>& k2Sums = {},
+                         const std::vector<T>& kSums = {})
+    {
+        if (rank_ != 0) { return; }
+
+        shellCounts_.assign(counts.begin(), counts.end());
+        shellPower_ = power_spectrum_;
+        shellK_.assign(numShells_, T(0));
+
+        T sum_ps_radial = std::accumulate(power_spectrum_.begin(), power_spectrum_.end(), 0.0);
+        std::cout << "sum_ps_radial: " << sum_ps_radial << std::endl;
+
+        int minBinCount = 64;
+        if (const char* env = std::getenv("PS_MIN_BIN_COUNT")) minBinCount = std::max(1, std::atoi(env));
+        shellMinCount_ = minBinCount;
+
+        std::vector<T> normalized(numShells_, T(0));
+        for (int i = 0; i < numShells_;)
+        {
+            int j = i;
+            T   psSum = power_spectrum_[i];
+            int cSum  = counts[i];
 
-            std::vector<T> normalized(numShells_, T(0));
-            for (int i = 0; i < numShells_;)
+            while (j + 1 < numShells_ && cSum > 0 && cSum < minBinCount)
             {
-                int j = i;
-                T   psSum = power_spectrum_[i];
-                int cSum  = counts[i];
+                ++j;
+                psSum += power_spectrum_[j];
+                cSum += counts[j];
+            }
 
-                while (j + 1 < numShells_ && cSum > 0 && cSum < minBinCount)
+            if (cSum > 0)
+            {
+                T   k2Weighted = 0;
+                T   kWeighted  = 0;
+                int cForK      = 0;
+                for (int b = i; b <= j; b++)
                 {
-                    ++j;
-                    psSum += power_spectrum_[j];
-                    cSum += counts[j];
+                    if (counts[b] == 0) continue;
+                    int kb = std::min(b, gridDim_ - 1);
+                    k2Weighted += k2Sums.empty() ? std::pow(k_1d[kb], 2) * counts[b] : k2Sums[b];
+                    kWeighted += kSums.empty() ? k_1d[kb] * counts[b] : kSums[b];
+                    cForK += counts[b];
                 }
-
-                if (cSum > 0)
+                if (cForK == 0)
                 {
-                    T   k2Weighted = 0;
-                    int cForK      = 0;
-                    for (int b = i; b <= j; b++)
-                    {
-                        if (counts[b] == 0) continue;
-                        int kb = std::min(b, gridDim_ - 1);
-                        k2Weighted += std::pow(k_1d[kb], 2) * counts[b];
-                        cForK += counts[b];
-                    }
-                    if (cForK == 0)
-                    {
-                        int kb = std::min(i, gridDim_ - 1);
-                        k2Weighted = std::pow(k_1d[kb], 2);
-                        cForK = 1;
-                    }
-
-                    T k2Mean = k2Weighted / static_cast<T>(cForK);
-                    T val    = (psSum / static_cast<T>(cSum)) * 4.0 * std::numbers::pi * k2Mean;
-                    for (int b = i; b <= j; b++) normalized[b] = val;
+                    int kb = std::min(i, gridDim_ - 1);
+                    k2Weighted = std::pow(k_1d[kb], 2);
+                    kWeighted  = k_1d[kb];
+                    cForK = 1;
                 }
 
-                i = j + 1;
+                T k2Mean = k2Weighted / static_cast<T>(cForK);
+                T val    = (psSum / static_cast<T>(cSum)) * 4.0 * std::numbers::pi * k2Mean;
+                for (int b = i; b <= j; b++)
+                {
+                    normalized[b] = val;
+                    shellK_[b]    = kWeighted / static_cast<T>(cForK);
+                }
             }
 
-            power_spectrum_.swap(normalized);
+            i = j + 1;
         }
 
-        // Free temporary device memory
-        cudaFree(d_k_values);
-        cudaFree(d_k_1d);
-        cudaFree(d_ps_rad);
-        cudaFree(d_count);
-        cudaFree(d_inboxSize);
-        cudaFree(d_inboxLow);
+        power_spectrum_.swap(normalized);
     }
-#endif
 
-    // The normalized power spectrum results will be stored in rank 0
-    void perform_spherical_averaging(T* ps)
+    /*! @brief bin the per-mode power @p ps into the shells, the normalized power spectrum is stored on rank 0
+     *
+     * With cylinderAxis_ set and @p withCylinder, the same voxel loop also fills the cylindrical (k_par, k_perp) bins.
+     * Every thread accumulates its own histograms, which are merged once per thread.
+     */
+    void perform_spherical_averaging(T* ps, bool withCylinder = true)
     {
         std::cout << "rank = " << rank_ << " spherical averaging started." << std::endl;
         std::vector<T>   k_values(gridDim_);
@@ -1167,95 +1781,187 @@ public:
             k_1d[i] = std::abs(k_values[i]);
         }
 
-// iterate over the ps array and assign the values to the correct radial bin
-#pragma omp parallel for collapse(3)
-        for (int i = 0; i < inbox_.size[2]; i++) // slow heffte order
+        buildShellMap(k_values);
+
+        bool cylinder = withCylinder && cylinderAxis_ >= 0;
+        if (cylinder) { buildCylinderMap(k_values); }
+
+        // custom shells are normalized with the k^2 of their modes, all shells report the mean |k| of their modes
+        std::vector<T> k2_rad(shellEdges_.empty() ? 0 : numShells_, T(0));
+        std::vector<T> k_rad(numShells_, T(0));
+
+        // power sums, mode counts as T and k_perp sums go through one reduction
+        uint64_t       numCyl = cylinder ? uint64_t(gridDim_ / 2 + 1) * numShells_ : 0;
+        std::vector<T> cyl(3 * numCyl, T(0));
+        if (cylinder) { std::copy(cylinderKPerpSum_.begin(), cylinderKPerpSum_.end(), cyl.begin() + 2 * numCyl); }
+
+#pragma omp parallel
         {
-            for (int j = 0; j < inbox_.size[1]; j++) // mid heffte order
+            std::vector<T>   ps_local(numShells_, T(0));
+            std::vector<int> count_local(numShells_, 0);
+            std::vector<T>   k2_local(k2_rad.size(), T(0));
+            std::vector<T>   k_local(numShells_, T(0));
+            std::vector<T>   cyl_local(2 * numCyl, T(0));
+
+// iterate over the ps array and assign the values to the correct radial bin
+#pragma omp for collapse(3) nowait
+            for (int i = 0; i < inbox_.size[2]; i++) // slow heffte order
+            {
+                for (int j = 0; j < inbox_.size[1]; j++) // mid heffte order
+                {
+                    for (int k = 0; k < inbox_.size[0]; k++) // fast heffte order
+                    {
+                        uint64_t freq_index = k + j * inbox_.size[0] + i * inbox_.size[0] * inbox_.size[1];
+
+                        // Calculate the k indices with respect to the global mesh
+                        uint64_t         k_index_i = i + inbox_.low[2];
+                        uint64_t         k_index_j = j + inbox_.low[1];
+                        uint64_t         k_index_k = k + inbox_.low[0];
+                        std::array<T, 3> kc{k_values[k_index_k], k_values[k_index_j], k_values[k_index_i]};
+
+                        int shell = shellOfMode_[freq_index];
+                        if (shell >= 0)
+                        {
+                            T k2 = kc[0] * kc[0] + kc[1] * kc[1] + kc[2] * kc[2];
+                            ps_local[shell] += ps[freq_index];
+                            count_local[shell]++;
+                            k_local[shell] += std::sqrt(k2);
+                            if (!k2_local.empty()) { k2_local[shell] += k2; }
+                        }
+
+                        if (cylinder && cylinderBinOfMode_[freq_index] >= 0)
+                        {
+                            uint64_t bin = cylinderBinOfMode_[freq_index];
+                            cyl_local[bin] += ps[freq_index];
+                            cyl_local[numCyl + bin] += T(1);
+                        }
+                    }
+                }
+            }
+
+#pragma omp critical
             {
-                for (int k = 0; k < inbox_.size[0]; k++) // fast heffte order
+                for (int s = 0; s < numShells_; s++)
+                {
+                    ps_rad[s] += ps_local[s];
+                    count[s] += count_local[s];
+                    k_rad[s] += k_local[s];
+                }
+                for (size_t s = 0; s < k2_rad.size(); s++)
+                {
+                    k2_rad[s] += k2_local[s];
+                }
+                for (size_t b = 0; b < cyl_local.size(); b++)
                 {
-                    uint64_t freq_index = k + j * inbox_.size[0] + i * inbox_.size[0] * inbox_.size[1];
-
-                    // Calculate the k indices with respect to the global mesh
-                    uint64_t       k_index_i = i + inbox_.low[2];
-                    uint64_t       k_index_j = j + inbox_.low[1];
-                    uint64_t       k_index_k = k + inbox_.low[0];
-                    T              kdist     = std::sqrt(k_values[k_index_i] * k_values[k_index_i] +
-                                                         k_values[k_index_j] * k_values[k_index_j] +
-                                                         k_values[k_index_k] * k_values[k_index_k]);
-                    uint64_t k_index = std::min(static_cast<uint64_t>(std::round(kdist)),
-                                                static_cast<uint64_t>(numShells_ - 1));
-
-#pragma omp atomic
-                    ps_rad[k_index] += ps[freq_index];
-#pragma omp atomic
-                    count[k_index]++;
+                    cyl[b] += cyl_local[b];
                 }
             }
         }
 
         MPI_Reduce(ps_rad.data(), power_spectrum_.data(), numShells_, MpiType<T>{}, MPI_SUM, 0, MPI_COMM_WORLD);
         MPI_Reduce(count.data(), counts.data(), numShells_, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+        MPI_Reduce(rank_ == 0 ? MPI_IN_PLACE : k_rad.data(), k_rad.data(), numShells_, MpiType<T>{}, MPI_SUM, 0,
+                   MPI_COMM_WORLD);
+        if (!k2_rad.empty())
+        {
+            MPI_Reduce(rank_ == 0 ? MPI_IN_PLACE : k2_rad.data(), k2_rad.data(), numShells_, MpiType<T>{}, MPI_SUM, 0,
+                       MPI_COMM_WORLD);
+        }
 
-        // normalize the power spectrum
-        if (rank_ == 0)
+        if (cylinder)
         {
-            T sum_ps_radial = std::accumulate(power_spectrum_.begin(), power_spectrum_.end(), 0.0);
+            MPI_Reduce(rank_ == 0 ? MPI_IN_PLACE : cyl.data(), cyl.data(), cyl.size(), MpiType<T>{}, MPI_SUM, 0,
+                       MPI_COMM_WORLD);
+            if (rank_ == 0)
+            {
+                cylinderPower_.assign(cyl.begin(), cyl.begin() + numCyl);
+                cylinderCounts_.resize(numCyl);
+                cylinderKPerp_.resize(numCyl);
+                for (uint64_t b = 0; b < numCyl; b++)
+                {
+                    cylinderCounts_[b] = static_cast<int>(std::lround(cyl[numCyl + b]));
+                    cylinderKPerp_[b]  = cylinderCounts_[b] > 0 ? cyl[2 * numCyl + b] / cylinderCounts_[b] : T(0);
+                }
+            }
+        }
 
-            std::cout << "sum_ps_radial: " << sum_ps_radial << std::endl;
+        normalizeShells(counts, k_1d, k2_rad, k_rad);
+    }
 
-            int minBinCount = 64;
-            if (const char* env = std::getenv("PS_MIN_BIN_COUNT")) minBinCount = std::max(1, std::atoi(env));
+    //! @brief fill shellOfMode_ for the local inbox modes unless it is already built for the current shells
+    void buildShellMap(const std::vector<T>& k_values)
+    {
+        uint64_t numModes = static_cast<uint64_t>(inbox_.count());
+        if (shellOfMode_.size() == numModes) { return; }
+        shellOfMode_.resize(numModes);
 
-            std::vector<T> normalized(numShells_, T(0));
-            for (int i = 0; i < numShells_;)
+#pragma omp parallel for collapse(3)
+        for (int i = 0; i < inbox_.size[2]; i++)
+        {
+            for (int j = 0; j < inbox_.size[1]; j++)
             {
-                int j = i;
-                T   psSum = power_spectrum_[i];
-                int cSum  = counts[i];
-
-                while (j + 1 < numShells_ && cSum > 0 && cSum < minBinCount)
+                for (int k = 0; k < inbox_.size[0]; k++)
                 {
-                    ++j;
-                    psSum += power_spectrum_[j];
-                    cSum += counts[j];
+                    T kx = k_values[k + inbox_.low[0]];
+                    T ky = k_values[j + inbox_.low[1]];
+                    T kz = k_values[i + inbox_.low[2]];
+                    shellOfMode_[k + uint64_t(j) * inbox_.size[0] + uint64_t(i) * inbox_.size[0] * inbox_.size[1]] =
+                        shellIndex(std::sqrt(kx * kx + ky * ky + kz * kz));
                 }
+            }
+        }
+    }
+
+    //! @brief fill cylinderBinOfMode_ and cylinderKPerpSum_ for the local modes unless built for the axis and shells
+    void buildCylinderMap(const std::vector<T>& k_values)
+    {
+        uint64_t numModes = static_cast<uint64_t>(inbox_.count());
+        if (cylinderBinOfMode_.size() == numModes && cylinderBinAxis_ == cylinderAxis_) { return; }
+        cylinderBinOfMode_.resize(numModes);
+        cylinderBinAxis_ = cylinderAxis_;
+        cylinderKPerpSum_.assign(uint64_t(gridDim_ / 2 + 1) * numShells_, T(0));
+
+#pragma omp parallel
+        {
+            std::vector<T> kPerpLocal(cylinderKPerpSum_.size(), T(0));
 
-                if (cSum > 0)
+#pragma omp for collapse(3) nowait
+            for (int i = 0; i < inbox_.size[2]; i++)
+            {
+                for (int j = 0; j < inbox_.size[1]; j++)
                 {
-                    T   k2Weighted = 0;
-                    int cForK      = 0;
-                    for (int b = i; b <= j; b++)
-                    {
-                        if (counts[b] == 0) continue;
-                        int kb = std::min(b, gridDim_ - 1);
-                        k2Weighted += std::pow(k_1d[kb], 2) * counts[b];
-                        cForK += counts[b];
-                    }
-                    if (cForK == 0)
+                    for (int k = 0; k < inbox_.size[0]; k++)
                     {
-                        int kb = std::min(i, gridDim_ - 1);
-                        k2Weighted = std::pow(k_1d[kb], 2);
-                        cForK = 1;
+                        std::array<T, 3> kc{k_values[k + inbox_.low[0]], k_values[j + inbox_.low[1]],
+                                            k_values[i + inbox_.low[2]]};
+                        T   ka    = kc[(cylinderAxis_ + 1) % 3];
+                        T   kb    = kc[(cylinderAxis_ + 2) % 3];
+                        T   kPerp = std::sqrt(ka * ka + kb * kb);
+                        int kpar  = static_cast<int>(std::round(std::abs(kc[cylinderAxis_])));
+                        int shell = shellIndex(kPerp);
+                        int bin   = shell >= 0 ? kpar * numShells_ + shell : -1;
+                        cylinderBinOfMode_[k + uint64_t(j) * inbox_.size[0] +
+                                           uint64_t(i) * inbox_.size[0] * inbox_.size[1]] = bin;
+                        if (bin >= 0) { kPerpLocal[bin] += kPerp; }
                     }
-
-                    T k2Mean = k2Weighted / static_cast<T>(cForK);
-                    T val    = (psSum / static_cast<T>(cSum)) * 4.0 * std::numbers::pi * k2Mean;
-                    for (int b = i; b <= j; b++) normalized[b] = val;
                 }
-
-                i = j + 1;
             }
 
-            power_spectrum_.swap(normalized);
+#pragma omp critical
+            {
+                for (size_t b = 0; b < kPerpLocal.size(); b++)
+                {
+                    cylinderKPerpSum_[b] += kPerpLocal[b];
+                }
+            }
         }
     }
 
-    void rasterize_particles_to_mesh_cell_avg(const std::vector<KeyType>& keys, const std::vector<T>& x,
-                                               const std::vector<T>& y, const std::vector<T>& z,
-                                               const std::vector<T>& vx, const std::vector<T>& vy,
-                                               const std::vector<T>& vz, int powerDim)
+    template<class P>
+    void rasterize_particles_to_mesh_cell_avg(const std::vector<KeyType>& keys, const std::vector<P>& x,
+                                               const std::vector<P>& y, const std::vector<P>& z,
+                                               const std::vector<P>& vx, const std::vector<P>& vy,
+                                               const std::vector<P>& vz, int powerDim)
     {
         // std::cout << "rank" << rank_ << " rasterize start (cell_avg) " << powerDim << std::endl;
         // std::cout << "rank" << rank_ << " keys between " << keys.front() << " - " << keys.back() << std::endl;
@@ -1264,13 +1970,127 @@ public:
                              static_cast<uint64_t>(inbox_.size[2]);
 
         // Reset accumulators and communication state
-        std::fill(cellAvgVelX_.begin(), cellAvgVelX_.end(), T(0));
-        std::fill(cellAvgVelY_.begin(), cellAvgVelY_.end(), T(0));
-        std::fill(cellAvgVelZ_.begin(), cellAvgVelZ_.end(), T(0));
-        std::fill(cellCount_.begin(), cellCount_.end(), 0);
+        if (!accumulateBlocks_)
+        {
+            std::fill(cellAvgVelX_.begin(), cellAvgVelX_.end(), T(0));
+            std::fill(cellAvgVelY_.begin(), cellAvgVelY_.end(), T(0));
+            std::fill(cellAvgVelZ_.begin(), cellAvgVelZ_.end(), T(0));
+            std::fill(cellCount_.begin(), cellCount_.end(), 0);
+        }
         std::fill(send_count.begin(), send_count.end(), 0);
         std::fill(send_disp.begin(), send_disp.end(), 0);
         std::fill(recv_disp.begin(), recv_disp.end(), 0);
+        deferredParticles_.clear();
+
+        if (subgridReshape_)
+        {
+            // velocity sums and particle counts per cell, counts are carried as T through the reshape
+            std::vector<T> countSum(inboxSize, T(0));
+            Subgrids       sg =
+                beginSubgrids({cellAvgVelX_.data(), cellAvgVelY_.data(), cellAvgVelZ_.data(), countSum.data()});
+            for (KeyType key : keys)
+            {
+                auto [i, j, k] = calculateKeyIndices(key, gridDim_);
+                addSubgridCells(sg, {i, j, k}, {i, j, k});
+            }
+            allocateSubgrids(sg);
+            for (size_t p = 0; p < keys.size(); p++)
+            {
+                auto [i, j, k] = calculateKeyIndices(keys[p], gridDim_);
+                depositSubgrid<4>(sg, i, j, k, {T(vx[p]), T(vy[p]), T(vz[p]), T(1)});
+            }
+            reshapeSubgrids(sg);
+            for (uint64_t i = 0; i < inboxSize; i++)
+            {
+                cellCount_[i] += static_cast<int>(std::lround(countSum[i]));
+            }
+
+            finalizeCellAverages();
+            extrapolateEmptyCellsFromNeighbors();
+            return;
+        }
+
+        if (exchangeBudgetBytes_ > 0)
+        {
+            struct Record
+            {
+                uint32_t index;
+                int      npart;
+                T        vx, vy, vz;
+            };
+
+            // consecutive particles for the same remote cell are merged into the last staged record
+            size_t cursor  = 0;
+            auto   produce = [&](std::vector<std::pair<int, Record>>& staging, size_t capacity)
+            {
+                for (; cursor < keys.size() && staging.size() < capacity; cursor++)
+                {
+                    auto     crd         = calculateKeyIndices(keys[cursor], gridDim_);
+                    int      indexi      = std::get<0>(crd);
+                    int      indexj      = std::get<1>(crd);
+                    int      indexk      = std::get<2>(crd);
+                    int      targetRank  = calculateRankFromMeshCoord(indexi, indexj, indexk);
+                    uint32_t targetIndex = calculateInboxIndexFromMeshCoord(indexi, indexj, indexk);
+                    if (targetRank == rank_)
+                    {
+                        cellAvgVelX_[targetIndex] += vx[cursor];
+                        cellAvgVelY_[targetIndex] += vy[cursor];
+                        cellAvgVelZ_[targetIndex] += vz[cursor];
+                        cellCount_[targetIndex]++;
+                    }
+                    else if (!staging.empty() && staging.back().first == targetRank &&
+                             staging.back().second.index == targetIndex)
+                    {
+                        Record& rec = staging.back().second;
+                        rec.npart++;
+                        rec.vx += vx[cursor];
+                        rec.vy += vy[cursor];
+                        rec.vz += vz[cursor];
+                    }
+                    else
+                    {
+                        staging.push_back({targetRank, Record{targetIndex, 1, vx[cursor], vy[cursor], vz[cursor]}});
+                    }
+                }
+                return cursor < keys.size();
+            };
+            auto apply = [&](const Record* records, size_t count)
+            {
+                for (size_t i = 0; i < count; i++)
+                {
+                    const Record& rec = records[i];
+                    cellAvgVelX_[rec.index] += rec.vx;
+                    cellAvgVelY_[rec.index] += rec.vy;
+                    cellAvgVelZ_[rec.index] += rec.vz;
+                    cellCount_[rec.index] += rec.npart;
+                }
+            };
+            chunkedExchange<Record>(exchangeBudgetBytes_, produce, apply, sparseExchange_, MPI_COMM_WORLD);
+
+            finalizeCellAverages();
+            extrapolateEmptyCellsFromNeighbors();
+            return;
+        }
+
+        // Remote particles are combined over runs of consecutive (SFC-ordered) particles that share a cell and
+        // shipped as (cell, velocity sums, particle count) instead of one record per particle.
+        int      runRank  = -1;
+        uint32_t runIndex = 0;
+        T        runVx = 0, runVy = 0, runVz = 0;
+        int      runCount = 0;
+
+        auto flushRun = [&]()
+        {
+            if (runRank < 0) return;
+            auto& sender = vdataSenderCellAvg[runRank];
+            send_count[runRank]++;
+            sender.send_index.push_back(runIndex);
+            sender.send_vx.push_back(runVx);
+            sender.send_vy.push_back(runVy);
+            sender.send_vz.push_back(runVz);
+            sender.send_npart.push_back(runCount);
+            runRank = -1;
+        };
 
         int particleIndex = 0;
         for (auto it = keys.begin(); it != keys.end(); ++it)
@@ -1281,9 +2101,10 @@ public:
             int  indexk = std::get<2>(crd);
 
             int      targetRank  = calculateRankFromMeshCoord(indexi, indexj, indexk);
-            uint64_t targetIndex = calculateInboxIndexFromMeshCoord(indexi, indexj, indexk);
+            uint32_t targetIndex = calculateInboxIndexFromMeshCoord(indexi, indexj, indexk);
 
-            if (targetRank == rank_)
+            if (targetRank == rank_ && overlapExchange_) { deferredParticles_.push_back(particleIndex); }
+            else if (targetRank == rank_)
             {
                 cellAvgVelX_[targetIndex] += vx[particleIndex];
                 cellAvgVelY_[targetIndex] += vy[particleIndex];
@@ -1292,16 +2113,24 @@ public:
             }
             else
             {
-                send_count[targetRank]++;
-                vdataSenderCellAvg[targetRank].send_index.push_back(targetIndex);
-                vdataSenderCellAvg[targetRank].send_vx.push_back(vx[particleIndex]);
-                vdataSenderCellAvg[targetRank].send_vy.push_back(vy[particleIndex]);
-                vdataSenderCellAvg[targetRank].send_vz.push_back(vz[particleIndex]);
+                if (targetRank != runRank || targetIndex != runIndex)
+                {
+                    flushRun();
+                    runRank  = targetRank;
+                    runIndex = targetIndex;
+                    runVx = runVy = runVz = 0;
+                    runCount          = 0;
+                }
+                runVx += vx[particleIndex];
+                runVy += vy[particleIndex];
+                runVz += vz[particleIndex];
+                runCount++;
             }
             particleIndex++;
         }
+        flushRun();
 
-        MPI_Alltoall(send_count.data(), 1, MpiType<int>{}, recv_count.data(), 1, MpiType<int>{}, MPI_COMM_WORLD);
+        exchangeCounts(send_count, recv_count, sparseExchange_, MPI_COMM_WORLD);
 
         for (int i = 0; i < numRanks_; i++)
         {
@@ -1314,6 +2143,7 @@ public:
         send_vx_cavg.resize(send_disp[numRanks_]);
         send_vy_cavg.resize(send_disp[numRanks_]);
         send_vz_cavg.resize(send_disp[numRanks_]);
+        send_npart_cavg.resize(send_disp[numRanks_]);
 
         for (int i = 0; i < numRanks_; i++)
         {
@@ -1324,6 +2154,7 @@ public:
                 send_vx_cavg[j]    = vdataSenderCellAvg[i].send_vx[local];
                 send_vy_cavg[j]    = vdataSenderCellAvg[i].send_vy[local];
                 send_vz_cavg[j]    = vdataSenderCellAvg[i].send_vz[local];
+                send_npart_cavg[j] = vdataSenderCellAvg[i].send_npart[local];
             }
         }
 
@@ -1331,39 +2162,58 @@ public:
         recv_vx_cavg.resize(recv_disp[numRanks_]);
         recv_vy_cavg.resize(recv_disp[numRanks_]);
         recv_vz_cavg.resize(recv_disp[numRanks_]);
-
-        MPI_Alltoallv(send_index_cavg.data(), send_count.data(), send_disp.data(), MpiType<uint64_t>{},
-                      recv_index_cavg.data(), recv_count.data(), recv_disp.data(), MpiType<uint64_t>{}, MPI_COMM_WORLD);
-        MPI_Alltoallv(send_vx_cavg.data(), send_count.data(), send_disp.data(), MpiType<T>{},
-                      recv_vx_cavg.data(), recv_count.data(), recv_disp.data(), MpiType<T>{}, MPI_COMM_WORLD);
-        MPI_Alltoallv(send_vy_cavg.data(), send_count.data(), send_disp.data(), MpiType<T>{},
-                      recv_vy_cavg.data(), recv_count.data(), recv_disp.data(), MpiType<T>{}, MPI_COMM_WORLD);
-        MPI_Alltoallv(send_vz_cavg.data(), send_count.data(), send_disp.data(), MpiType<T>{},
-                      recv_vz_cavg.data(), recv_count.data(), recv_disp.data(), MpiType<T>{}, MPI_COMM_WORLD);
+        recv_npart_cavg.resize(recv_disp[numRanks_]);
 
         // Accumulate remote contributions
-        for (int i = 0; i < recv_disp[numRanks_]; i++)
+        auto applyReceived = [&](int first, int last)
         {
-            uint64_t index = recv_index_cavg[i];
-            cellAvgVelX_[index] += recv_vx_cavg[i];
-            cellAvgVelY_[index] += recv_vy_cavg[i];
-            cellAvgVelZ_[index] += recv_vz_cavg[i];
-            cellCount_[index]++;
-        }
+            for (int i = first; i < last; i++)
+            {
+                uint64_t index = recv_index_cavg[i];
+                cellAvgVelX_[index] += recv_vx_cavg[i];
+                cellAvgVelY_[index] += recv_vy_cavg[i];
+                cellAvgVelZ_[index] += recv_vz_cavg[i];
+                cellCount_[index] += recv_npart_cavg[i];
+            }
+        };
 
-        // Finalise: write averages into velX_/Y_/Z_; mark filled/empty for extrapolation
-        std::fill(distance_.begin(), distance_.end(), std::numeric_limits<T>::infinity());
-        for (uint64_t i = 0; i < inboxSize; i++)
+        if (overlapExchange_)
         {
-            if (cellCount_[i] > 0)
+            PendingExchange exchange(send_count, send_disp, recv_count, recv_disp, MPI_COMM_WORLD);
+            exchange.postIndices(send_index_cavg, recv_index_cavg, compressIndexExchange_);
+            exchange.post(send_vx_cavg.data(), recv_vx_cavg.data());
+            exchange.post(send_vy_cavg.data(), recv_vy_cavg.data());
+            exchange.post(send_vz_cavg.data(), recv_vz_cavg.data());
+            exchange.post(send_npart_cavg.data(), recv_npart_cavg.data());
+
+            for (int p : deferredParticles_)
             {
-                velX_[i]     = cellAvgVelX_[i] / static_cast<T>(cellCount_[i]);
-                velY_[i]     = cellAvgVelY_[i] / static_cast<T>(cellCount_[i]);
-                velZ_[i]     = cellAvgVelZ_[i] / static_cast<T>(cellCount_[i]);
-                distance_[i] = T(0); // finite sentinel → cell is filled
+                auto     crd         = calculateKeyIndices(keys[p], gridDim_);
+                uint32_t targetIndex = calculateInboxIndexFromMeshCoord(std::get<0>(crd), std::get<1>(crd),
+                                                                        std::get<2>(crd));
+                cellAvgVelX_[targetIndex] += vx[p];
+                cellAvgVelY_[targetIndex] += vy[p];
+                cellAvgVelZ_[targetIndex] += vz[p];
+                cellCount_[targetIndex]++;
             }
-            // else: velX_/Y_/Z_ remains 0, distance_ remains infinity → will be extrapolated
+            exchange.drain([&](int r) { applyReceived(recv_disp[r], recv_disp[r] + recv_count[r]); });
         }
+        else
+        {
+            exchangeIndices(send_index_cavg, send_count, send_disp, recv_index_cavg, recv_count, recv_disp,
+                            compressIndexExchange_, sparseExchange_, MPI_COMM_WORLD);
+            exchangeValues(send_vx_cavg.data(), send_count, send_disp, recv_vx_cavg.data(), recv_count, recv_disp,
+                           sparseExchange_, MPI_COMM_WORLD);
+            exchangeValues(send_vy_cavg.data(), send_count, send_disp, recv_vy_cavg.data(), recv_count, recv_disp,
+                           sparseExchange_, MPI_COMM_WORLD);
+            exchangeValues(send_vz_cavg.data(), send_count, send_disp, recv_vz_cavg.data(), recv_count, recv_disp,
+                           sparseExchange_, MPI_COMM_WORLD);
+            exchangeValues(send_npart_cavg.data(), send_count, send_disp, recv_npart_cavg.data(), recv_count,
+                           recv_disp, sparseExchange_, MPI_COMM_WORLD);
+            applyReceived(0, recv_disp[numRanks_]);
+        }
+
+        finalizeCellAverages();
 
         // Clear send buffers
         for (int i = 0; i < numRanks_; i++)
@@ -1372,12 +2222,31 @@ public:
             vdataSenderCellAvg[i].send_vx.clear();
             vdataSenderCellAvg[i].send_vy.clear();
             vdataSenderCellAvg[i].send_vz.clear();
+            vdataSenderCellAvg[i].send_npart.clear();
         }
 
         extrapolateEmptyCellsFromNeighbors();
         std::cout << "rank = " << rank_ << " rasterize (cell_avg) done!" << std::endl;
     }
 
+    // Finalise: write averages into velX_/Y_/Z_; mark filled/empty for extrapolation
+    void finalizeCellAverages()
+    {
+        if (accumulateBlocks_) return;
+        std::fill(distance_.begin(), distance_.end(), std::numeric_limits<T>::infinity());
+        for (uint64_t i = 0; i < cellCount_.size(); i++)
+        {
+            if (cellCount_[i] > 0)
+            {
+                velX_[i]     = cellAvgVelX_[i] / static_cast<T>(cellCount_[i]);
+                velY_[i]     = cellAvgVelY_[i] / static_cast<T>(cellCount_[i]);
+                velZ_[i]     = cellAvgVelZ_[i] / static_cast<T>(cellCount_[i]);
+                distance_[i] = T(0); // finite sentinel → cell is filled
+            }
+            // else: velX_/Y_/Z_ remains 0, distance_ remains infinity → will be extrapolated
+        }
+    }
+
     void setSimBox(T Lmin, T Lmax)
     {
         Lmin_ = Lmin;
@@ -1521,6 +2390,174 @@ public:
         return xLocal + yLocal * xSize + zLocal * xSize * ySize;
     }
 
+    //! @brief local index of global cell (i, j, k) in a box with the inbox memory layout (x fastest)
+    static uint64_t boxIndex(const heffte::box3d<>& box, int i, int j, int k)
+    {
+        return (i - box.low[0]) + static_cast<uint64_t>(j - box.low[1]) * box.size[0] +
+               static_cast<uint64_t>(k - box.low[2]) * box.size[0] * box.size[1];
+    }
+
+    /*! @brief remote deposits of the subgrid reshape, one box per destination inbox
+     *
+     * Each remote inbox gets the bounding box of the cells deposited into it, so a few particles away from the others
+     * (periodic halos, stragglers) add a small box for their own destination instead of stretching a single box over
+     * the grid. Deposits into the local inbox go straight to the inbox fields.
+     */
+    struct Subgrids
+    {
+        std::vector<heffte::box3d<>>    inboxes;   // inboxes of all ranks
+        std::vector<std::array<int, 3>> low, high; // deposit bounds per rank, empty while high < low
+        std::vector<heffte::box3d<>>    boxes;     // per rank box of the bounds, set by allocateSubgrids
+        std::vector<uint64_t>           count;     // values per rank, box cells times number of fields
+        std::vector<uint64_t>           disp;      // offsets of the ranks' values, size numRanks + 1
+        std::vector<T>                  values;    // per rank one field after the other, each in boxIndex layout
+        std::vector<T*>                 targets;   // local inbox fields, one per field
+    };
+
+    //! @brief subgrids without deposits, @p targets are the inbox fields receiving the sums
+    Subgrids beginSubgrids(const std::vector<T*>& targets)
+    {
+        heffte::box3d<> allIndexes({0, 0, 0}, {gridDim_ - 1, gridDim_ - 1, gridDim_ - 1});
+
+        Subgrids sg;
+        sg.inboxes = heffte::split_world(allIndexes, proc_grid_);
+        sg.low.assign(numRanks_, {gridDim_, gridDim_, gridDim_});
+        sg.high.assign(numRanks_, {-1, -1, -1});
+        sg.targets = targets;
+        return sg;
+    }
+
+    //! @brief index of the inbox slab that holds global cell @p g along dimension @p d
+    int inboxCoordinate(int g, int d) const
+    {
+        int base   = gridDim_ / proc_grid_[d];
+        int rem    = gridDim_ % proc_grid_[d];
+        int cutoff = (base + 1) * rem;
+        return g < cutoff ? g / (base + 1) : rem + (g - cutoff) / base;
+    }
+
+    //! @brief grow the deposit bounds of the remote inboxes overlapping the global cells [@p low, @p high]
+    void addSubgridCells(Subgrids& sg, const std::array<int, 3>& low, const std::array<int, 3>& high)
+    {
+        std::array<int, 3> first, last;
+        for (int d = 0; d < 3; d++)
+        {
+            first[d] = inboxCoordinate(low[d], d);
+            last[d]  = inboxCoordinate(high[d], d);
+        }
+        for (int pz = first[2]; pz <= last[2]; pz++)
+            for (int py = first[1]; py <= last[1]; py++)
+                for (int px = first[0]; px <= last[0]; px++)
+                {
+                    int r = px + py * proc_grid_[0] + pz * proc_grid_[0] * proc_grid_[1];
+                    if (r == rank_) continue;
+                    for (int d = 0; d < 3; d++)
+                    {
+                        sg.low[r][d]  = std::min(sg.low[r][d], std::max(low[d], sg.inboxes[r].low[d]));
+                        sg.high[r][d] = std::max(sg.high[r][d], std::min(high[d], sg.inboxes[r].high[d]));
+                    }
+                }
+    }
+
+    //! @brief zeroed remote boxes of the deposit bounds, called once all of them have been added
+    void allocateSubgrids(Subgrids& sg)
+    {
+        uint64_t numFields = sg.targets.size();
+        sg.count.assign(numRanks_, 0);
+        sg.disp.assign(numRanks_ + 1, 0);
+        for (int r = 0; r < numRanks_; r++)
+        {
+            sg.boxes.emplace_back(sg.low[r], sg.high[r]);
+            sg.count[r]    = sg.boxes[r].empty() ? 0 : sg.boxes[r].count() * numFields;
+            sg.disp[r + 1] = sg.disp[r] + sg.count[r];
+        }
+        sg.values.assign(sg.disp[numRanks_], T(0));
+    }
+
+    //! @brief add @p values to the fields of global cell (i, j, k), which lies within the added deposit bounds
+    template<size_t N>
+    void depositSubgrid(Subgrids& sg, int i, int j, int k, const std::array<T, N>& values)
+    {
+        int r = calculateRankFromMeshCoord(i, j, k);
+        if (r == rank_)
+        {
+            uint64_t index = calculateInboxIndexFromMeshCoord(i, j, k);
+            for (size_t f = 0; f < N; f++)
+            {
+                sg.targets[f][index] += values[f];
+            }
+            return;
+        }
+
+        T*       cell   = sg.values.data() + sg.disp[r] + boxIndex(sg.boxes[r], i, j, k);
+        uint64_t stride = sg.boxes[r].count();
+        for (size_t f = 0; f < N; f++)
+        {
+            cell[f * stride] += values[f];
+        }
+    }
+
+    /*! @brief sum the remote boxes of all ranks into the inbox fields of their destinations
+     *
+     * This is a box-to-box reshape like heFFTe's reshape3d, except that overlapping boxes are summed instead of
+     * overwritten. Receivers first get the extents of the boxes headed their way. The values follow with 64-bit
+     * counts, so boxes of more than 2^31 values per rank are fine. Communication scales with the deposit boxes rather
+     * than with the number of particles.
+     */
+    void reshapeSubgrids(Subgrids& sg)
+    {
+        uint64_t numFields = sg.targets.size();
+
+        std::vector<int> extents, extentCount(numRanks_), extentDisp(numRanks_ + 1, 0);
+        for (int r = 0; r < numRanks_; r++)
+        {
+            if (sg.count[r] > 0)
+            {
+                extents.insert(extents.end(), sg.low[r].begin(), sg.low[r].end());
+                extents.insert(extents.end(), sg.high[r].begin(), sg.high[r].end());
+                extentCount[r] = 6;
+            }
+            extentDisp[r + 1] = extentDisp[r] + extentCount[r];
+        }
+        std::vector<int> recvExtentCount(numRanks_), recvExtentDisp(numRanks_ + 1, 0);
+        exchangeCounts(extentCount, recvExtentCount, sparseExchange_, MPI_COMM_WORLD);
+        std::partial_sum(recvExtentCount.begin(), recvExtentCount.end(), recvExtentDisp.begin() + 1);
+        std::vector<int> recvExtents(recvExtentDisp[numRanks_]);
+        exchangeValues(extents.data(), extentCount, extentDisp, recvExtents.data(), recvExtentCount, recvExtentDisp,
+                       sparseExchange_, MPI_COMM_WORLD);
+
+        std::vector<heffte::box3d<>> recvBoxes;
+        std::vector<uint64_t>        recvCount(numRanks_, 0), recvDisp(numRanks_ + 1, 0);
+        for (int r = 0; r < numRanks_; r++)
+        {
+            const int* e = recvExtents.data() + recvExtentDisp[r];
+            if (recvExtentCount[r] > 0) { recvBoxes.emplace_back(std::array<int, 3>{e[0], e[1], e[2]},
+                                                                 std::array<int, 3>{e[3], e[4], e[5]}); }
+            else { recvBoxes.emplace_back(std::array<int, 3>{0, 0, 0}, std::array<int, 3>{-1, -1, -1}); }
+            recvCount[r]    = recvBoxes[r].empty() ? 0 : recvBoxes[r].count() * numFields;
+            recvDisp[r + 1] = recvDisp[r] + recvCount[r];
+        }
+
+        std::vector<T> recvBuffer(recvDisp[numRanks_]);
+        exchangeValues(sg.values.data(), sg.count, sg.disp, recvBuffer.data(), recvCount, recvDisp, sparseExchange_,
+                       MPI_COMM_WORLD);
+        sg.values = std::vector<T>{};
+
+        for (int r = 0; r < numRanks_; r++)
+        {
+            if (recvCount[r] == 0) continue;
+            const auto& box = recvBoxes[r];
+            size_t      pos = recvDisp[r];
+            for (uint64_t f = 0; f < numFields; f++)
+                for (int k = box.low[2]; k <= box.high[2]; k++)
+                    for (int j = box.low[1]; j <= box.high[1]; j++)
+                        for (int i = box.low[0]; i <= box.high[0]; i++)
+                        {
+                            sg.targets[f][boxIndex(inbox_, i, j, k)] += recvBuffer[pos++];
+                        }
+        }
+    }
+
     std::tuple<int, int, int> calculateKeyIndices(KeyType key, int gridDim)
     {
         auto mesh_indices = cstone::decodeHilbert(key);
@@ -1537,11 +2574,13 @@ public:
     }
 
 private:
-    heffte::box3d<> initInbox()
+    heffte::box3d<> initInbox(const std::array<int, 3>& procGrid)
     {
         heffte::box3d<> all_indexes({0, 0, 0}, {gridDim_ - 1, gridDim_ - 1, gridDim_ - 1});
 
-        proc_grid_ = heffte::proc_setup_min_surface(all_indexes, numRanks_);
+        proc_grid_ = procGrid[0] * procGrid[1] * procGrid[2] == numRanks_
+                         ? procGrid
+                         : heffte::proc_setup_min_surface(all_indexes, numRanks_);
         // print proc_grid
         // std::cout << "rank = " << rank_ << " proc_grid: " << proc_grid_[0] << " " << proc_grid_[1] << " "
         //           << proc_grid_[2] << std::endl;
@@ -1568,6 +2607,31 @@ private:
     }
 };
 
+/*! @brief sort the particles of one checkpoint step into SFC order with halos, @p keys are resized to fit
+ *
+ * A cstone::Domain keeps the particle layout of its previous sync and expects the next one to continue from it, so
+ * each step gets a domain of its own. Only the meshes and their FFT plans carry over from one step to the next.
+ *
+ * @param props  std::tie of the particle properties to sync along, or std::tuple<> for none
+ * @return        the number of particles assigned to this rank, without halos
+ */
+template<class T, class... Props>
+size_t syncStep(int rank, int numRanks, uint64_t numGlobal, std::vector<KeyType>& keys, std::vector<T>& x,
+              std::vector<T>& y, std::vector<T>& z, std::vector<T>& h, std::tuple<Props&...> props)
+{
+    size_t         bucketSizeFocus = 64;
+    size_t         bucketSize      = std::max<size_t>(bucketSizeFocus, numGlobal / (100 * numRanks));
+    float          theta           = 1.0;
+    cstone::Box<T> box(-0.5, 0.5, cstone::BoundaryType::periodic); // boundary type from file?
+
+    cstone::Domain<KeyType, T, cstone::CpuTag> domain(rank, numRanks, bucketSize, bucketSizeFocus, theta, box);
+
+    std::vector<T> scratch1(x.size()), scratch2(x.size()), scratch3(x.size());
+    keys.resize(x.size());
+    domain.sync(keys, x, y, z, h, props, std::tie(scratch1, scratch2, scratch3));
+    return domain.nParticles();
+}
+
 // Forward declaration for CUDA rasterization function
 #ifdef USE_CUDA
 template<typename T>
@@ -1,5 +1,14 @@
 #include <algorithm>
 #include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
 #include <string>
 
 #ifdef USE_NVSHMEM
@@ -8,6 +17,7 @@
 #endif
 
 #include "mesh.hpp"
+#include "fft_tuning.hpp"
 #include "utils.hpp"
 #include "arg_parser.hpp"
 #include "ifile_io_impl.h"
@@ -23,6 +33,72 @@ using namespace sphexa;
 void printSpectrumHelp(char* binName, int rank);
 using MeshType = double;
 
+// precision of the particle buffers, the CPU rasterizers accept either and HDF5 converts from the file type on read
+#ifdef USE_FLOAT_PARTICLES
+using ParticleType = float;
+#else
+using ParticleType = double;
+#endif
+
+//! @brief particle fields of one checkpoint step, fields the rasterizer does not use stay empty
+struct StepParticles
+{
+    std::vector<ParticleType> x, y, z, h, vx, vy, vz;
+    //! SFC keys, only filled when the step comes already synced from the sync cache
+    std::vector<uint64_t>     keys;
+    uint64_t                  numLocal{0};
+    uint64_t                  numGlobal{0};
+    uint64_t                  readBytes{0};
+    double                    readSeconds{0};
+};
+
+std::vector<std::string> rasterFields(const std::string& fieldMode, const std::string& interpolationMode);
+StepParticles readStep(IFileReader& reader, const std::string& path, int step, const std::vector<std::string>& fields);
+void          reportReadBandwidth(const StepParticles& particles, int rank);
+bool          rawStepComplete(const std::string& rawRoot, const std::string& checkpoint, int step,
+                              const std::vector<std::string>& fields, int rank);
+void          writeRawStep(const std::string& rawRoot, const std::string& checkpoint, int step,
+                           const StepParticles& particles, const std::vector<std::string>& fields, int rank);
+bool          syncedStepCached(const std::string& syncRoot, const std::string& checkpoint, int step,
+                               std::vector<std::string> fields, int rank, int numRanks);
+StepParticles readSyncedStep(IFileReader& reader, const std::string& syncRoot, int step,
+                             const std::vector<std::string>& fields, int rank);
+void          writeSyncedStep(const std::string& syncRoot, const std::string& checkpoint, int step,
+                              const StepParticles& particles, const std::vector<std::string>& fields, int rank,
+                              int numRanks);
+H5PartReadTuning readTuning(const ArgParser& parser);
+std::vector<int> parseSteps(const std::string& spec);
+std::vector<MeshType> parseShellEdges(const std::string& spec);
+std::string   stepOutputFile(const std::string& outputFile, int step, bool multiStep);
+std::string   gridSizeOutputFile(const std::string& outputFile, int gridDim);
+std::string   fieldOutputFile(const std::string& outputFile, const std::string& fieldMode);
+std::string   cylinderOutputFile(const std::string& outputFile);
+void          writeGrid(Mesh<MeshType>& mesh, const std::string& path, const std::string& fieldMode, int step);
+
+//! @brief run parameters recorded with each spectrum in the structured output formats
+struct SpectrumInfo
+{
+    std::string checkpoint, fieldMode, interpolationMode;
+    int         step{0};
+    int         numRanks{1};
+    uint64_t    numParticles{0};
+};
+void writeSpectrum(const std::string& format, const std::string& outputFile, bool multiStep,
+                   const Mesh<MeshType>& mesh, const SpectrumInfo& info,
+                   const std::vector<std::pair<std::string, float>>& stages);
+std::string   checkpointIdentity(const std::string& checkpoint);
+bool          checkpointMatches(const std::string& stepDir, const std::string& checkpoint, int step,
+                                uint64_t numGlobal);
+void          writeCheckpointMatch(const std::string& stepDir, const std::string& checkpoint, uint64_t numGlobal);
+std::string   gridCacheKey(const std::string& checkpoint, int step, int gridSize, const std::string& interpolationMode,
+                           const std::string& fieldMode, int numRanks, bool usePencils,
+                           const std::array<int, 3>& procGrid);
+bool          gridCacheHit(const std::string& entry, int rank, uint64_t& numGlobal);
+void          loadGridCache(const std::string& entry, Mesh<MeshType>& mesh);
+void          storeGridCache(const std::string& entry, Mesh<MeshType>& mesh, uint64_t numGlobal);
+void streamRasterize(IFileReader& reader, Mesh<MeshType>& mesh, const std::string& fieldMode,
+                     const std::string& interpolationMode, uint64_t blockSize, int powerDim);
+
 enum class RasterBackend
 {
     Cpu,
@@ -30,6 +106,11 @@ enum class RasterBackend
     Nvshmem
 };
 
+void rasterizeDensity(Mesh<MeshType>& mesh, RasterBackend backend, StepParticles& particles, int powerDim);
+void rasterizeVelocity(Mesh<MeshType>& mesh, RasterBackend backend, const std::string& interpolationMode,
+                       StepParticles& particles, int powerDim);
+void weightBySqrtDensity(Mesh<MeshType>& mesh);
+
 RasterBackend selectBackend(const ArgParser& parser)
 {
     std::string mode = "auto";
@@ -60,9 +141,9 @@ int main(int argc, char** argv)
     // For CUDA builds, we need to ensure MPI is initialized before any CUDA operations
     // The CUDA runtime might initialize automatically when libraries are loaded,
     // so we initialize MPI first to avoid conflicts
-    auto [rank, numRanks] = initMpi();
-    
-    const ArgParser       parser(argc, (const char**)argv);
+    const ArgParser parser(argc, (const char**)argv);
+    auto [rank, numRanks] = initMpi(parser.exists("--prefetch") ? MPI_THREAD_MULTIPLE : MPI_THREAD_SINGLE);
+
     RasterBackend         backend = selectBackend(parser);
 
 
@@ -117,142 +198,1315 @@ int main(int argc, char** argv)
         std::cout << "Selected rasterization backend: " << backendName << std::endl;
     }
 
-    using KeyType        = uint64_t;
-    using CoordinateType = double;
-
-    using Domain = cstone::Domain<KeyType, CoordinateType, cstone::CpuTag>;
-    
     const std::string initFile           = parser.get("--checkpoint");
     int               stepNo             = parser.get("--stepNo", 0);
     int               meshSize           = parser.get("--gridSize", 0);
     size_t            numShells          = parser.get("--numShells", 0);
     std::string       interpolationMode  = parser.get<std::string>("--interpolation", "nearest"); // "nearest" or "sph"
-    std::string       fieldMode          = parser.get<std::string>("--field", "velocity");         // "velocity" or "density"
+    std::vector<std::string> fieldModes  = parser.getCommaList("--field"); // "velocity", "density", "sqrt_rho_velocity"
     std::string       outputFile         = parser.get<std::string>("--output", "power_spectrum.txt");
     bool              usePencils         = parser.exists("--pencils");
     bool              useCudaAwareMpi    = parser.exists("--cuda-aware-mpi");
     bool              useCudaAwareFullPack = parser.exists("--cuda-aware-full-pack");
+    bool              compressIndices    = parser.exists("--compress-indices");
+    bool              sparseExchange     = parser.exists("--sparse-exchange");
+    bool              overlapExchange    = parser.exists("--overlap-exchange");
+    bool              subgridReshape     = parser.exists("--subgrid-reshape");
+    size_t            exchangeBudgetMB   = parser.get("--exchange-budget-mb", 0);
+    uint64_t          streamBlock        = parser.get("--stream-block", 0);
+    int               numSteps           = parser.get("--numSteps", 1);
+    std::string       gridOutput         = parser.get<std::string>("--grid-output", "");
+    std::string       outputFormat       = parser.get<std::string>("--output-format", "text");
+    std::vector<std::string> coarseGrids = parser.getCommaList("--coarse-grids");
+    bool              helmholtz          = parser.exists("--helmholtz");
+    std::string       cylindrical        = parser.get<std::string>("--cylindrical", "");
+    std::vector<MeshType> shellEdges;
+    std::string       fftTuningFile      = parser.get<std::string>("--fft-tuning", "fft_tuning.txt");
 
     Timer timer(std::cout);
 
-    // read HDF5 checkpoint
-    auto reader = makeH5PartReader(MPI_COMM_WORLD);
-    reader->setStep(initFile, stepNo, FileMode::collective);
+    if (fieldModes.empty()) { fieldModes = {"velocity"}; }
+    for (const auto& fieldMode : fieldModes)
+    {
+        if (fieldMode != "velocity" && fieldMode != "density" && fieldMode != "sqrt_rho_velocity")
+        {
+            if (rank == 0)
+                std::cerr << "Unknown --field option: " << fieldMode
+                          << " (expected 'velocity', 'density' or 'sqrt_rho_velocity')" << std::endl;
+            return exitFailure();
+        }
+    }
+    bool multiField  = fieldModes.size() > 1;
+    bool vectorField = std::count(fieldModes.begin(), fieldModes.end(), "density") < long(fieldModes.size());
 
-    size_t numParticles = reader->globalNumParticles(); // total number of particles in the simulation
-    size_t simDim       = std::cbrt(numParticles);      // dimension of the simulation
+    if (helmholtz && !vectorField)
+    {
+        if (rank == 0) std::cerr << "--helmholtz needs a velocity field" << std::endl;
+        return exitFailure();
+    }
 
-    std::vector<double> x(reader->localNumParticles());
-    std::vector<double> y(reader->localNumParticles());
-    std::vector<double> z(reader->localNumParticles());
-    std::vector<double> h(reader->localNumParticles());
-    std::vector<double> vx(reader->localNumParticles());
-    std::vector<double> vy(reader->localNumParticles());
-    std::vector<double> vz(reader->localNumParticles());
-    std::vector<double> scratch1(x.size());
-    std::vector<double> scratch2(x.size());
-    std::vector<double> scratch3(x.size());
+    if (streamBlock > 0 && (multiField || fieldModes[0] == "sqrt_rho_velocity"))
+    {
+        if (rank == 0) std::cerr << "--stream-block rasterizes a single velocity or density field" << std::endl;
+        return exitFailure();
+    }
 
-    timer.start();
+    const std::string axisNames    = "xyz";
+    int               cylinderAxis = cylindrical.empty() ? -1 : int(axisNames.find(cylindrical));
+    if (!cylindrical.empty() && (cylindrical.size() != 1 || cylinderAxis < 0))
+    {
+        if (rank == 0)
+            std::cerr << "Unknown --cylindrical axis: " << cylindrical << " (expected x, y or z)" << std::endl;
+        return exitFailure();
+    }
 
-    reader->readField("x", x.data());
-    reader->readField("y", y.data());
-    reader->readField("z", z.data());
-    reader->readField("h", h.data());
-    reader->readField("vx", vx.data());
-    reader->readField("vy", vy.data());
-    reader->readField("vz", vz.data());
-    reader->closeStep();
+    if (parser.exists("--shell-edges"))
+    {
+        try
+        {
+            shellEdges = parseShellEdges(parser.get("--shell-edges"));
+        }
+        catch (const std::invalid_argument& e)
+        {
+            if (rank == 0) std::cerr << e.what() << std::endl;
+            return exitFailure();
+        }
+    }
 
-    timer.elapsed("Checkpoint read");
+    if (outputFormat != "text" && outputFormat != "jsonl" && outputFormat != "hdf5")
+    {
+        if (rank == 0)
+            std::cerr << "Unknown --output-format: " << outputFormat << " (expected 'text', 'jsonl' or 'hdf5')"
+                      << std::endl;
+        return exitFailure();
+    }
 
-    std::cout << "Read " << reader->localNumParticles() << " particles on rank " << rank << std::endl;
+    // tuning mode: benchmark the FFT settings of the grid sizes of this run, keep the fastest and exit
+    if (parser.exists("--tune-fft"))
+    {
+        if (meshSize <= 0)
+        {
+            if (rank == 0) std::cerr << "--tune-fft needs --gridSize" << std::endl;
+            return exitFailure();
+        }
+        std::vector<int> tuneSizes{meshSize};
+        for (const auto& coarse : coarseGrids)
+        {
+            tuneSizes.push_back(std::stoi(coarse));
+        }
+        for (int dim : tuneSizes)
+        {
+            FftTuning best = tuneFft<MeshType>(dim, rank, numRanks);
+            if (rank == 0)
+            {
+                storeFftTuning(fftTuningFile, dim, numRanks, sizeof(MeshType), best);
+                std::cout << "Tuned " << dim << "^3 FFT on " << numRanks << " ranks: processor grid " << best.procGrid[0]
+                          << "x" << best.procGrid[1] << "x" << best.procGrid[2] << (best.pencils ? " pencils" : " slabs")
+                          << (best.reorder ? " reorder " : " no-reorder ") << reshapeAlgorithmName(best.algorithm)
+                          << ", " << best.seconds << " s per transform, stored in " << fftTuningFile << std::endl;
+            }
+        }
+        return exitSuccess();
+    }
 
-    // get the dimensions from the checkpoint
-    int powerDim = std::ceil(std::log(simDim) / std::log(2));// + 1;
-    int gridDim;
-    if (meshSize > 0)
+    // --steps list, or consecutive steps starting at --stepNo, each one gets its own spectrum file
+    std::vector<int> steps(std::max(numSteps, 1));
+    std::iota(steps.begin(), steps.end(), stepNo);
+    if (parser.exists("--steps") && parser.exists("--numSteps"))
     {
-        gridDim = meshSize; // override if mesh size is provided as argument
+        if (rank == 0) std::cerr << "--steps and --numSteps both select the steps, give only one of them" << std::endl;
+        return exitFailure();
     }
-    else
+    if (parser.exists("--steps"))
     {
-        gridDim = simDim; // dimension of the mesh // std::pow(2, powerDim);
+        try
+        {
+            steps = parseSteps(parser.get("--steps"));
+        }
+        catch (const std::invalid_argument& e)
+        {
+            if (rank == 0) std::cerr << e.what() << std::endl;
+            return exitFailure();
+        }
     }
-    if (numShells == 0) numShells = gridDim / 2; // default number of shells is half of the mesh dimension
 
-    // init mesh, sim box -0.5 to 0.5 by default
-    Mesh<MeshType> mesh(rank, numRanks, gridDim, numShells);
-    mesh.usePencils_ = usePencils;
-    mesh.useCudaAwareMpi_ = useCudaAwareMpi;
-    mesh.useCudaAwareGpuPack_ = useCudaAwareFullPack;
+    // only the fields the rasterizers use are read and carried through the sync, once for all spectra
+    std::vector<std::string> fields      = rasterFields(vectorField ? "velocity" : "density", interpolationMode);
+    bool                     useVelocity = std::count(fields.begin(), fields.end(), "vx") > 0;
 
-    if (rank == 0 && mesh.useCudaAwareMpi_)
+    H5PartReadTuning ioTuning;
+    try
+    {
+        ioTuning = readTuning(parser);
+    }
+    catch (const std::invalid_argument& e)
     {
-        std::cout << "CUDA-aware MPI exchange path requested for CUDA rasterization methods." << std::endl;
-        if (mesh.useCudaAwareGpuPack_)
-            std::cout << "Full GPU rank-packing enabled (experimental)." << std::endl;
+        if (rank == 0) std::cerr << e.what() << std::endl;
+        return exitFailure();
     }
+    auto reader = makeH5PartReader(MPI_COMM_WORLD, ioTuning);
 
-    // mesh.assign_velocities_to_mesh(x.data(), y.data(), z.data(), vx.data(), vy.data(), vz.data(), simDim, gridDim);
+    // the next step is read on a background thread with its own reader and communicator while this one is processed
+    bool prefetch    = parser.exists("--prefetch") && steps.size() > 1 && streamBlock == 0;
+    int  threadLevel = MPI_THREAD_SINGLE;
+    MPI_Query_thread(&threadLevel);
+    if (prefetch && threadLevel < MPI_THREAD_MULTIPLE)
+    {
+        if (rank == 0) std::cout << "MPI_THREAD_MULTIPLE is not available, reading steps without prefetch.\n";
+        prefetch = false;
+    }
+    // the background read runs alongside the HDF5 grid and spectrum writes of the main thread
+    if (prefetch && !h5ThreadSafe())
+    {
+        if (rank == 0) std::cout << "The HDF5 library is not thread-safe, reading steps without prefetch.\n";
+        prefetch = false;
+    }
 
-    // create cornerstone tree
-    std::vector<KeyType> keys(x.size());
-    size_t               bucketSizeFocus = 64;
-    size_t               bucketSize      = std::max(bucketSizeFocus, numParticles / (100 * numRanks));
-    float                theta           = 1.0;
-    cstone::Box<double>  box(-0.5, 0.5, cstone::BoundaryType::periodic); // boundary type from file?
-    Domain               domain(rank, numRanks, bucketSize, bucketSizeFocus, theta, box);
+    // steps found in the raw sidecar with all needed fields are mapped from there, the others are added to it
+    bool        useRawCache = parser.exists("--raw-cache");
+    std::string rawRoot     = parser.get<std::string>("--raw-cache", initFile + ".raw");
+    auto        rawReader   = makeRawReader(MPI_COMM_WORLD);
 
-    domain.sync(keys, x, y, z, h, std::tie(vx, vy, vz), std::tie(scratch1, scratch2, scratch3));
-    // std::cout << "rank = " << rank << " numLocalParticles after sync = " << domain.nParticles() << std::endl;
-    // std::cout << "rank = " << rank << " numLocalParticleswithHalos after sync = " << domain.nParticlesWithHalos()
-    //           << std::endl;
-    // std::cout << "rank = " << rank << " keys size after sync = " << keys.size() << std::endl;
-    // std::cout << "rank = " << rank << " keys.begin = " << *keys.begin() << " keys.end = " << *keys.end() <<
-    // std::endl;
+    MPI_Comm                     prefetchComm = MPI_COMM_NULL;
+    std::unique_ptr<IFileReader> prefetchReader;
+    std::unique_ptr<IFileReader> prefetchRawReader;
+    std::future<StepParticles>   nextStep;
+    if (prefetch)
+    {
+        MPI_Comm_dup(MPI_COMM_WORLD, &prefetchComm);
+        prefetchReader    = makeH5PartReader(prefetchComm, ioTuning);
+        prefetchRawReader = makeRawReader(prefetchComm);
+    }
 
-    scratch1.clear();
-    scratch2.clear();
-    scratch3.clear();
+    // post-sync particles per rank count, a hit skips both the checkpoint read and the domain sync
+    bool        useSyncCache = parser.exists("--sync-cache");
+    std::string syncRoot     = parser.get<std::string>("--sync-cache", initFile + ".synced") + "/ranks_" +
+                           std::to_string(numRanks);
 
-    timer.elapsed("Sync");
+    // tuned FFT settings per grid size from the tuning file, looked up once
+    std::map<int, std::optional<FftTuning>> fftTunings;
+    auto                                    tuningFor = [&](int dim) -> const std::optional<FftTuning>&
+    {
+        if (!fftTunings.count(dim))
+        {
+            fftTunings[dim] = loadFftTuning(fftTuningFile, dim, numRanks, sizeof(MeshType), rank);
+        }
+        return fftTunings[dim];
+    };
 
-    if (fieldMode != "velocity" && fieldMode != "density")
+    // rasterized grids per rank, a hit goes straight to the FFT
+    bool        useGridCache = parser.exists("--grid-cache");
+    std::string gridCacheDir = parser.get<std::string>("--grid-cache", initFile + ".gridcache");
+    auto        gridEntry    = [&](int step, const std::string& fieldMode)
     {
-        if (rank == 0)
-            std::cerr << "Unknown --field option: " << fieldMode << " (expected 'velocity' or 'density')" << std::endl;
-        return exitFailure();
-    }
+        std::array<int, 3> procGrid{0, 0, 0};
+        if (meshSize > 0 && tuningFor(meshSize)) { procGrid = tuningFor(meshSize)->procGrid; }
+        return gridCacheDir + "/" +
+               gridCacheKey(initFile, step, meshSize, interpolationMode, fieldMode, numRanks, usePencils, procGrid);
+    };
+    // a step skips read and sync only if the grids of all its fields are cached
+    auto inGridCache = [&](int step, uint64_t& numGlobal)
+    {
+        bool hit = useGridCache;
+        for (size_t i = 0; i < fieldModes.size() && hit; i++)
+        {
+            hit = gridCacheHit(gridEntry(step, fieldModes[i]), rank, numGlobal);
+        }
+        return hit;
+    };
 
-    // Choose particle-to-grid field
-    if (fieldMode == "density")
+    auto inRawCache  = [&](int step) { return useRawCache && rawStepComplete(rawRoot, initFile, step, fields, rank); };
+    auto inSyncCache = [&](int step)
+    { return useSyncCache && streamBlock == 0 && syncedStepCached(syncRoot, initFile, step, fields, rank, numRanks); };
+    // the cache decision is collective, it is made before the load which may run on the prefetch thread
+    auto loadStep = [&](IFileReader& h5Reader, IFileReader& raw, int step, bool fromRaw)
+    { return fromRaw ? readStep(raw, rawRoot, step, fields) : readStep(h5Reader, initFile, step, fields); };
+
+    std::unique_ptr<Mesh<MeshType>>              meshPtr;
+    std::vector<std::unique_ptr<Mesh<MeshType>>> coarseMeshes;
+    int                             powerDim = 0;
+
+    for (size_t stepIndex = 0; stepIndex < steps.size(); stepIndex++)
     {
-        if (rank == 0) std::cout << "Using density rasterization" << std::endl;
-        if (backend == RasterBackend::Cuda)
+        int           step = steps[stepIndex];
+        StepParticles particles;
+        bool          fromGridCache = inGridCache(step, particles.numGlobal);
+        bool          fromRaw       = inRawCache(step);
+        bool          fromSynced    = !fromGridCache && inSyncCache(step);
+        IFileReader&  source        = fromRaw ? *rawReader : *reader;
+
+        timer.start();
+
+        // in streaming mode the particles are read block-wise during rasterization instead
+        if (fromGridCache)
+        {
+            if (rank == 0) std::cout << "Step " << step << " found in the grid cache" << std::endl;
+        }
+        else if (streamBlock > 0)
+        {
+            source.setStep(fromRaw ? rawRoot : initFile, step, FileMode::collective);
+            particles.numGlobal = source.globalNumParticles();
+            particles.numLocal  = source.localNumParticles();
+        }
+        else if (fromSynced)
+        {
+            particles = readSyncedStep(*rawReader, syncRoot, step, fields, rank);
+            timer.elapsed("Sync cache read");
+            reportReadBandwidth(particles, rank);
+        }
+        else if (nextStep.valid())
+        {
+            particles = nextStep.get();
+            timer.elapsed("Checkpoint prefetch wait");
+            reportReadBandwidth(particles, rank);
+        }
+        else
+        {
+            particles = loadStep(*reader, *rawReader, step, fromRaw);
+            timer.elapsed("Checkpoint read");
+            reportReadBandwidth(particles, rank);
+        }
+
+        if (useRawCache && streamBlock == 0 && !fromRaw && !fromSynced && !fromGridCache)
+        {
+            writeRawStep(rawRoot, initFile, step, particles, fields, rank);
+            timer.elapsed("Raw sidecar write");
+        }
+
+        uint64_t nextNumGlobal = 0;
+        if (prefetch && stepIndex + 1 < steps.size() && !inSyncCache(steps[stepIndex + 1]) &&
+            !inGridCache(steps[stepIndex + 1], nextNumGlobal))
+        {
+            nextStep = std::async(std::launch::async, loadStep, std::ref(*prefetchReader), std::ref(*prefetchRawReader),
+                                  steps[stepIndex + 1], inRawCache(steps[stepIndex + 1]));
+        }
+
+        std::cout << "Read " << particles.numLocal << " particles of step " << step << " on rank " << rank << std::endl;
+
+        std::vector<ParticleType>& x  = particles.x;
+        std::vector<ParticleType>& y  = particles.y;
+        std::vector<ParticleType>& z  = particles.z;
+        std::vector<ParticleType>& h  = particles.h;
+        std::vector<ParticleType>& vx = particles.vx;
+        std::vector<ParticleType>& vy = particles.vy;
+        std::vector<ParticleType>& vz = particles.vz;
+
+        // the meshes and their FFT plans are set up from the first step and reused for the following ones
+        if (!meshPtr)
+        {
+            size_t numParticles = particles.numGlobal;     // total number of particles in the simulation
+            size_t simDim       = std::cbrt(numParticles); // dimension of the simulation
+
+            // get the dimensions from the checkpoint
+            powerDim = std::ceil(std::log(simDim) / std::log(2));// + 1;
+            int gridDim;
+            if (meshSize > 0)
+            {
+                gridDim = meshSize; // override if mesh size is provided as argument
+            }
+            else
+            {
+                gridDim = simDim; // dimension of the mesh // std::pow(2, powerDim);
+            }
+            if (numShells == 0) numShells = gridDim / 2; // default number of shells is half of the mesh dimension
+
+            auto configure = [&](Mesh<MeshType>& m)
+            {
+                m.usePencils_            = usePencils;
+                m.useCudaAwareMpi_       = useCudaAwareMpi;
+                m.useCudaAwareGpuPack_   = useCudaAwareFullPack;
+                m.compressIndexExchange_ = compressIndices;
+                m.sparseExchange_        = sparseExchange;
+                m.overlapExchange_       = overlapExchange;
+                m.subgridReshape_        = subgridReshape;
+                m.exchangeBudgetBytes_   = exchangeBudgetMB << 20;
+                m.helmholtzSplit_        = helmholtz;
+                m.cylinderAxis_          = cylinderAxis;
+                if (!shellEdges.empty()) { m.setShellEdges(shellEdges); }
+            };
+
+            // meshes take the processor grid and plan options of the tuning file if it has their grid size
+            auto makeMesh = [&](int dim, int shells)
+            {
+                const auto& tuned = tuningFor(dim);
+                auto        m     = std::make_unique<Mesh<MeshType>>(rank, numRanks, dim, shells,
+                                                                 tuned ? tuned->procGrid : std::array<int, 3>{0, 0, 0});
+                configure(*m);
+                if (tuned)
+                {
+                    m->usePencils_   = usePencils || tuned->pencils;
+                    m->fftReorder_   = tuned->reorder;
+                    m->fftAlgorithm_ = tuned->algorithm;
+                    if (rank == 0)
+                        std::cout << "Using tuned FFT settings for " << dim << "^3 from " << fftTuningFile << std::endl;
+                }
+                return m;
+            };
+
+            // init mesh, sim box -0.5 to 0.5 by default
+            meshPtr = makeMesh(gridDim, numShells);
+            if (!vectorField) { meshPtr->releaseVectorComponents(); }
+
+            // coarser grids restricted from this one, with the same shells per grid size ratio
+            for (const auto& coarse : coarseGrids)
+            {
+                int coarseDim = std::stoi(coarse);
+                if (coarseDim <= 0 || coarseDim >= gridDim || gridDim % coarseDim != 0)
+                {
+                    if (rank == 0)
+                        std::cerr << "--coarse-grids: " << coarse << " does not divide the grid size " << gridDim
+                                  << std::endl;
+                    return exitFailure();
+                }
+                int coarseShells = std::max<int>(1, numShells * coarseDim / gridDim);
+                coarseMeshes.push_back(makeMesh(coarseDim, coarseShells));
+            }
+
+            if (rank == 0 && meshPtr->useCudaAwareMpi_)
+            {
+                std::cout << "CUDA-aware MPI exchange path requested for CUDA rasterization methods." << std::endl;
+                if (meshPtr->useCudaAwareGpuPack_)
+                    std::cout << "Full GPU rank-packing enabled (experimental)." << std::endl;
+            }
+        }
+        else { meshPtr->resetRasterFields(); }
+
+        Mesh<MeshType>& mesh = *meshPtr;
+
+        // mesh.assign_velocities_to_mesh(x.data(), y.data(), z.data(), vx.data(), vy.data(), vz.data(), simDim, gridDim);
+
+        std::vector<KeyType>& keys = particles.keys;
+        // a step loaded from the sync cache already is in its synced order
+        bool syncParticles = streamBlock == 0 && !fromSynced && !fromGridCache;
+        if (syncParticles && useVelocity)
+        {
+            syncStep(rank, numRanks, particles.numGlobal, keys, x, y, z, h, std::tie(vx, vy, vz));
+        }
+        else if (syncParticles) { syncStep(rank, numRanks, particles.numGlobal, keys, x, y, z, h, std::tuple<>{}); }
+        // std::cout << "rank = " << rank << " numLocalParticles after sync = " << domain.nParticles() << std::endl;
+        // std::cout << "rank = " << rank << " numLocalParticleswithHalos after sync = " << domain.nParticlesWithHalos()
+        //           << std::endl;
+        // std::cout << "rank = " << rank << " keys size after sync = " << keys.size() << std::endl;
+        // std::cout << "rank = " << rank << " keys.begin = " << *keys.begin() << " keys.end = " << *keys.end() <<
+        // std::endl;
+
+        timer.elapsed("Sync");
+
+        if (useSyncCache && syncParticles)
+        {
+            writeSyncedStep(syncRoot, initFile, step, particles, fields, rank, numRanks);
+            timer.elapsed("Sync cache write");
+        }
+
+        // density and velocity grids are rasterized at most once per step, the velocity grid is kept while more than
+        // one field is derived from it
+        bool                                 densityReady  = false;
+        bool                                 velocityReady = false;
+        long                                 velocityUses  = std::count_if(fieldModes.begin(), fieldModes.end(),
+                                                                           [](const auto& f) { return f != "density"; });
+        std::array<std::vector<MeshType>, 3> velocityGrid;
+        auto label = [multiField](const std::string& stage, const std::string& fieldMode)
+        { return multiField ? stage + " " + fieldMode : stage; };
+
+        for (const auto& fieldMode : fieldModes)
         {
+            bool fieldFromGridCache =
+                fromGridCache || (useGridCache && gridCacheHit(gridEntry(step, fieldMode), rank, particles.numGlobal));
+            // the density spectrum transforms and bins velX_ only
+            mesh.scalarField_    = fieldMode == "density";
+            mesh.helmholtzSplit_ = helmholtz && !mesh.scalarField_;
+
+            // Choose particle-to-grid field
+            if (fieldFromGridCache)
+            {
+                loadGridCache(gridEntry(step, fieldMode), mesh);
+            }
+            else if (streamBlock > 0)
+            {
+                if (rank == 0) std::cout << "Streaming the checkpoint in blocks of " << streamBlock << " particles\n";
+                if (backend != RasterBackend::Cpu && rank == 0)
+                    std::cout << "Streaming rasterization is implemented on the CPU/MPI path only, using it." << std::endl;
+                streamRasterize(source, mesh, fieldMode, interpolationMode, streamBlock, powerDim);
+                source.closeStep();
+            }
+            else
+            {
+                if (fieldMode != "velocity" && !densityReady)
+                {
+                    rasterizeDensity(mesh, backend, particles, powerDim);
+                    densityReady = true;
+                }
+                if (fieldMode != "density" && !velocityReady)
+                {
+                    rasterizeVelocity(mesh, backend, interpolationMode, particles, powerDim);
+                    velocityReady = true;
+                    if (velocityUses > 1)
+                    {
+                        mesh.copyGridToHost();
+                        velocityGrid = {mesh.velX_, mesh.velY_, mesh.velZ_};
+                    }
+                }
+                else if (fieldMode != "density")
+                {
+                    mesh.velX_ = velocityGrid[0];
+                    mesh.velY_ = velocityGrid[1];
+                    mesh.velZ_ = velocityGrid[2];
 #ifdef USE_CUDA
-            rasterize_particles_to_density_cuda(mesh, keys, x, y, z, powerDim);
-#else
-            mesh.rasterize_particles_to_density(keys, x, y, z, powerDim);
+                    mesh.gpuDataValid_ = false;
 #endif
+                }
+
+                if (fieldMode == "density")
+                {
+                    mesh.velX_ = mesh.density_;
+#ifdef USE_CUDA
+                    mesh.gpuDataValid_ = false;
+#endif
+                }
+                else if (fieldMode == "sqrt_rho_velocity") { weightBySqrtDensity(mesh); }
+            }
+
+            // mesh.rasterize_using_cornerstone(keys, x, y, z, vx, vy, vz, powerDim);
+            std::cout << "rasterized" << std::endl;
+            timer.elapsed(label("Rasterization", fieldMode));
+
+            if (useGridCache && !fieldFromGridCache)
+            {
+                storeGridCache(gridEntry(step, fieldMode), mesh, particles.numGlobal);
+                timer.elapsed(label("Grid cache write", fieldMode));
+            }
+
+            if (!gridOutput.empty())
+            {
+                std::string gridFile = multiField ? fieldOutputFile(gridOutput, fieldMode) : gridOutput;
+                writeGrid(mesh, stepOutputFile(gridFile, step, steps.size() > 1), fieldMode, step);
+                timer.elapsed(label("Grid write", fieldMode));
+            }
+
+            // text spectra of several fields go to one file per field, the structured formats tell them apart
+            std::string fieldOutput =
+                multiField && outputFormat == "text" ? fieldOutputFile(outputFile, fieldMode) : outputFile;
+            SpectrumInfo info{initFile, fieldMode, interpolationMode, step, numRanks, particles.numGlobal};
+
+            // coarse spectra come first, the fine FFT overwrites the grid
+            for (auto& coarse : coarseMeshes)
+            {
+                coarse->resetRasterFields();
+                coarse->restrictFrom(mesh);
+                coarse->scalarField_    = mesh.scalarField_;
+                coarse->helmholtzSplit_ = mesh.helmholtzSplit_;
+                coarse->calculate_power_spectrum();
+                timer.elapsed(label("Power Spectrum " + std::to_string(coarse->gridDim_), fieldMode));
+
+                if (rank == 0)
+                {
+                    std::string file =
+                        outputFormat == "text" ? gridSizeOutputFile(fieldOutput, coarse->gridDim_) : fieldOutput;
+                    writeSpectrum(outputFormat, file, steps.size() > 1, *coarse, info, timer.stages());
+                }
+            }
+
+            // calculate power spectrum
+            mesh.calculate_power_spectrum();
+            timer.elapsed(label("Power Spectrum", fieldMode));
+
+            // mesh.power_spectrum_ has the normalized data on rank 0
+            if (rank == 0) { writeSpectrum(outputFormat, fieldOutput, steps.size() > 1, mesh, info, timer.stages()); }
         }
-        else
+    }
+
+    if (prefetch)
+    {
+        prefetchReader.reset();
+        prefetchRawReader.reset();
+        MPI_Comm_free(&prefetchComm);
+    }
+
+    int exitCode = exitSuccess();
+#ifdef USE_NVSHMEM
+    if (backend == RasterBackend::Nvshmem)
+    {
+        nvshmem_barrier_all();
+        nvshmem_finalize();
+    }
+#endif
+    return exitCode;
+}
+
+//! @brief names of the checkpoint fields the selected rasterizer reads, coordinates first
+std::vector<std::string> rasterFields(const std::string& fieldMode, const std::string& interpolationMode)
+{
+    std::vector<std::string> fields{"x", "y", "z"};
+    if (fieldMode == "density") { return fields; }
+    if (interpolationMode == "sph") { fields.push_back("h"); }
+    fields.insert(fields.end(), {"vx", "vy", "vz"});
+    return fields;
+}
+
+//! @brief name -> buffer map of the particle fields of a (const) StepParticles
+template<class P>
+auto fieldBuffers(P& particles)
+{
+    return std::map<std::string, decltype(&particles.x)>{
+        {"x", &particles.x},   {"y", &particles.y},   {"z", &particles.z},  {"h", &particles.h},
+        {"vx", &particles.vx}, {"vy", &particles.vy}, {"vz", &particles.vz}};
+}
+
+//! @brief read @p fields of a checkpoint step into this rank's share of the particles, h is zero unless listed
+StepParticles readStep(IFileReader& reader, const std::string& path, int step, const std::vector<std::string>& fields)
+{
+    double start = MPI_Wtime();
+    reader.setStep(path, step, FileMode::collective);
+
+    StepParticles particles;
+    particles.numLocal  = reader.localNumParticles();
+    particles.numGlobal = reader.globalNumParticles();
+    particles.h.assign(particles.numLocal, 0.0);
+
+    auto buffers = fieldBuffers(particles);
+    for (const auto& field : fields)
+    {
+        buffers.at(field)->resize(particles.numLocal);
+        reader.readField(field, buffers.at(field)->data());
+    }
+    reader.closeStep();
+
+    particles.readBytes   = particles.numLocal * fields.size() * sizeof(ParticleType);
+    particles.readSeconds = MPI_Wtime() - start;
+    return particles;
+}
+
+//! @brief whether the raw step directory of @p step below @p root holds all of @p fields
+bool rawStepHasFields(const std::string& root, int step, const std::vector<std::string>& fields)
+{
+    auto stored = rawStepFields(root, step);
+    return std::all_of(fields.begin(), fields.end(),
+                       [&stored](const auto& f) { return std::find(stored.begin(), stored.end(), f) != stored.end(); });
+}
+
+/*! @brief whether the raw sidecar holds all of @p fields for @p step of the current @p checkpoint
+ *
+ * Decided on rank 0 and broadcast, so that all ranks take the same read path.
+ */
+bool rawStepComplete(const std::string& rawRoot, const std::string& checkpoint, int step,
+                     const std::vector<std::string>& fields, int rank)
+{
+    int hit = 0;
+    if (rank == 0)
+    {
+        hit = rawStepHasFields(rawRoot, step, fields) &&
+              checkpointMatches(rawStepDirectory(rawRoot, step), checkpoint, step, rawStepNumParticles(rawRoot, step));
+    }
+    MPI_Bcast(&hit, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    return hit;
+}
+
+/*! @brief add the fields of a step read from the checkpoint to the raw sidecar, in the checkpoint's particle order
+ *
+ * Fields stored from an older version of the checkpoint are dropped first.
+ */
+void writeRawStep(const std::string& rawRoot, const std::string& checkpoint, int step,
+                  const StepParticles& particles, const std::vector<std::string>& fields, int rank)
+{
+    std::string stepDir = rawStepDirectory(rawRoot, step);
+    if (rank == 0 && !checkpointMatches(stepDir, checkpoint, step, particles.numGlobal))
+    {
+        std::error_code ec;
+        std::filesystem::remove_all(stepDir, ec);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    auto buffers = fieldBuffers(particles);
+    auto writer = makeRawWriter(MPI_COMM_WORLD);
+    writer->addStep(0, particles.numLocal, stepDir);
+    for (const auto& field : fields)
+    {
+        writer->writeField(field, buffers.at(field)->data(), 0);
+    }
+    writer->closeStep();
+
+    if (rank == 0) { writeCheckpointMatch(stepDir, checkpoint, particles.numGlobal); }
+    MPI_Barrier(MPI_COMM_WORLD);
+}
+
+/*! @brief the sync cache stores the post-sync particles of every rank as a raw step
+ *
+ * The ranks' ranges are concatenated in rank order, i.e. in SFC order, together with their keys. A layout file next
+ * to the raw header holds the number of checkpoint particles and the rank split points. The cache is only valid for
+ * the rank count it was written with, which is part of @p syncRoot, and for the version of @p checkpoint it was
+ * synced from. The hit is decided on rank 0 and broadcast, so that all ranks take the same read path.
+ */
+bool syncedStepCached(const std::string& syncRoot, const std::string& checkpoint, int step,
+                      std::vector<std::string> fields, int rank, int numRanks)
+{
+    int hit = 0;
+    if (rank == 0)
+    {
+        fields.push_back("keys");
+        std::string           stepDir = rawStepDirectory(syncRoot, step);
+        std::ifstream         layout(stepDir + "/layout");
+        std::string           key;
+        uint64_t              numGlobal = 0, split;
+        std::vector<uint64_t> splits;
+        layout >> key >> numGlobal >> key;
+        while (layout >> split)
         {
-            if (backend == RasterBackend::Nvshmem && rank == 0)
-                std::cout << "NVSHMEM density rasterizer is not implemented, using CPU/MPI density path." << std::endl;
-            mesh.rasterize_particles_to_density(keys, x, y, z, powerDim);
+            splits.push_back(split);
         }
+        hit = rawStepHasFields(syncRoot, step, fields) && splits.size() == size_t(numRanks) + 1 &&
+              splits.back() == rawStepNumParticles(syncRoot, step) &&
+              checkpointMatches(stepDir, checkpoint, step, numGlobal);
+    }
+    MPI_Bcast(&hit, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    return hit;
+}
 
-        // Reuse existing spectrum pipeline (velX + velY + velZ) by storing density as scalar component.
-        mesh.velX_ = mesh.density_;
-        std::fill(mesh.velY_.begin(), mesh.velY_.end(), 0.0);
-        std::fill(mesh.velZ_.begin(), mesh.velZ_.end(), 0.0);
+//! @brief load this rank's post-sync particles and keys of @p step, h is zero unless listed
+StepParticles readSyncedStep(IFileReader& reader, const std::string& syncRoot, int step,
+                             const std::vector<std::string>& fields, int rank)
+{
+    double start = MPI_Wtime();
+
+    StepParticles         particles;
+    std::vector<uint64_t> splits;
+    std::ifstream         layout(rawStepDirectory(syncRoot, step) + "/layout");
+    std::string           key;
+    uint64_t              split;
+    layout >> key >> particles.numGlobal >> key;
+    while (layout >> split)
+    {
+        splits.push_back(split);
+    }
+    if (splits.size() < size_t(rank) + 2) { throw std::runtime_error("Sync cache layout does not match rank count"); }
+
+    // independent mode exposes all particles, the view then picks this rank's range
+    reader.setStep(syncRoot, step, FileMode::independent);
+    reader.setLocalView(splits[rank], splits[rank + 1]);
+    particles.numLocal = splits[rank + 1] - splits[rank];
+    particles.h.assign(particles.numLocal, 0.0);
+
+    auto buffers = fieldBuffers(particles);
+    for (const auto& field : fields)
+    {
+        buffers.at(field)->resize(particles.numLocal);
+        reader.readField(field, buffers.at(field)->data());
+    }
+    particles.keys.resize(particles.numLocal);
+    reader.readField("keys", particles.keys.data());
+    reader.closeStep();
+
+    particles.readBytes   = particles.numLocal * (fields.size() * sizeof(ParticleType) + sizeof(uint64_t));
+    particles.readSeconds = MPI_Wtime() - start;
+    return particles;
+}
+
+/*! @brief store the post-sync particles and keys of @p step, including any halos, so that a re-run can skip the sync
+ *
+ * A step synced from an older version of the checkpoint is dropped first.
+ */
+void writeSyncedStep(const std::string& syncRoot, const std::string& checkpoint, int step,
+                     const StepParticles& particles, const std::vector<std::string>& fields, int rank, int numRanks)
+{
+    uint64_t              numLocal = particles.keys.size();
+    std::vector<uint64_t> splits(numRanks + 1, 0);
+    MPI_Allgather(&numLocal, 1, MPI_UINT64_T, splits.data() + 1, 1, MPI_UINT64_T, MPI_COMM_WORLD);
+    std::partial_sum(splits.begin(), splits.end(), splits.begin());
+
+    std::string stepDir = rawStepDirectory(syncRoot, step);
+    if (rank == 0 && !checkpointMatches(stepDir, checkpoint, step, particles.numGlobal))
+    {
+        std::error_code ec;
+        std::filesystem::remove_all(stepDir, ec);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    auto buffers = fieldBuffers(particles);
+    auto        writer  = makeRawWriter(MPI_COMM_WORLD);
+    writer->addStep(0, numLocal, stepDir);
+    for (const auto& field : fields)
+    {
+        writer->writeField(field, buffers.at(field)->data(), 0);
+    }
+    writer->writeField("keys", particles.keys.data(), 0);
+    writer->closeStep();
+
+    if (rank == 0)
+    {
+        std::ofstream layout(stepDir + "/layout");
+        layout << "numGlobal " << particles.numGlobal << "\nsplits";
+        for (auto s : splits)
+        {
+            layout << " " << s;
+        }
+        layout << "\n";
+        layout.close();
+        writeCheckpointMatch(stepDir, checkpoint, particles.numGlobal);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+}
+
+//! @brief print the aggregate read bandwidth of a step, limited by the slowest rank
+void reportReadBandwidth(const StepParticles& particles, int rank)
+{
+    uint64_t bytes   = particles.readBytes;
+    double   seconds = particles.readSeconds;
+    MPI_Allreduce(MPI_IN_PLACE, &bytes, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, &seconds, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    if (rank == 0 && seconds > 0)
+    {
+        std::cout << "Checkpoint read bandwidth: " << (bytes >> 20) << " MB in " << seconds << " s, "
+                  << double(bytes) / (1 << 20) / seconds << " MB/s" << std::endl;
+    }
+}
+
+/*! @brief MPI-IO tuning from the command line
+ *
+ * --io-hints takes comma separated key=value pairs passed to MPI_File_open, --io-aggregators enables collective
+ * buffering with that many aggregators and --io-align-bytes aligns the rank boundaries to e.g. the file stripe size.
+ *
+ * @throws std::invalid_argument on malformed hints
+ */
+H5PartReadTuning readTuning(const ArgParser& parser)
+{
+    H5PartReadTuning tuning;
+    if (parser.exists("--io-hints"))
+    {
+        std::stringstream items(parser.get("--io-hints"));
+        std::string       item;
+        while (std::getline(items, item, ','))
+        {
+            size_t split = item.find('=');
+            if (split == 0 || split == std::string::npos) { throw std::invalid_argument("Invalid --io-hints item: " + item); }
+            tuning.hints.emplace_back(item.substr(0, split), item.substr(split + 1));
+        }
+    }
+    if (parser.exists("--io-aggregators"))
+    {
+        tuning.hints.emplace_back("romio_cb_read", "enable");
+        tuning.hints.emplace_back("cb_nodes", std::to_string(parser.get("--io-aggregators", 1)));
+    }
+    tuning.alignBytes = parser.get("--io-align-bytes", 0);
+    return tuning;
+}
+
+/*! @brief parse a comma separated list of steps and inclusive ranges first:last[:stride], e.g. "0:100:10,150"
+ *
+ * @throws std::invalid_argument on malformed items
+ */
+std::vector<int> parseSteps(const std::string& spec)
+{
+    std::vector<int>  steps;
+    std::stringstream items(spec);
+    std::string       item;
+    while (std::getline(items, item, ','))
+    {
+        std::vector<int>  bounds;
+        std::stringstream parts(item);
+        std::string       part;
+        while (std::getline(parts, part, ':'))
+        {
+            size_t used = 0;
+            int    value = 0;
+            try
+            {
+                value = std::stoi(part, &used);
+            }
+            catch (const std::exception&)
+            {
+                used = 0;
+            }
+            if (used == 0 || used != part.size()) { throw std::invalid_argument("Invalid --steps item: " + item); }
+            bounds.push_back(value);
+        }
+
+        if (bounds.size() == 1) { steps.push_back(bounds[0]); }
+        else if (bounds.size() <= 3)
+        {
+            int stride = bounds.size() == 3 ? bounds[2] : 1;
+            if (stride <= 0 || bounds[1] < bounds[0]) { throw std::invalid_argument("Invalid --steps range: " + item); }
+            for (int step = bounds[0]; step <= bounds[1]; step += stride)
+            {
+                steps.push_back(step);
+            }
+        }
+        else { throw std::invalid_argument("Invalid --steps item: " + item); }
+    }
+    if (steps.empty()) { throw std::invalid_argument("Empty --steps list"); }
+    return steps;
+}
+
+/*! @brief parse shell edges "log:kmin:kmax:numShells" or a comma separated list of ascending |k| values
+ *
+ * @throws std::invalid_argument on malformed specs
+ */
+std::vector<MeshType> parseShellEdges(const std::string& spec)
+{
+    auto number = [&spec](const std::string& item)
+    {
+        size_t   used  = 0;
+        MeshType value = 0;
+        try
+        {
+            value = std::stod(item, &used);
+        }
+        catch (const std::exception&)
+        {
+            used = 0;
+        }
+        if (used == 0 || used != item.size()) { throw std::invalid_argument("Invalid --shell-edges: " + spec); }
+        return value;
+    };
+
+    std::vector<std::string> items;
+    std::stringstream        parts(spec);
+    std::string              item;
+    if (spec.rfind("log:", 0) == 0)
+    {
+        parts.ignore(4);
+        while (std::getline(parts, item, ':'))
+        {
+            items.push_back(item);
+        }
+        if (items.size() != 3) { throw std::invalid_argument("Invalid --shell-edges: " + spec); }
+        return Mesh<MeshType>::logShellEdges(number(items[0]), number(items[1]), int(number(items[2])));
+    }
+
+    std::vector<MeshType> edges;
+    while (std::getline(parts, item, ','))
+    {
+        edges.push_back(number(item));
+    }
+    if (!Mesh<MeshType>::validShellEdges(edges)) { throw std::invalid_argument("Invalid --shell-edges: " + spec); }
+    return edges;
+}
+
+//! @brief spectrum file of one step, runs over several steps append the step number to the file name stem
+std::string stepOutputFile(const std::string& outputFile, int step, bool multiStep)
+{
+    if (!multiStep) { return outputFile; }
+    std::filesystem::path path(outputFile);
+    std::string           name = path.stem().string() + "_" + std::to_string(step) + path.extension().string();
+    return (path.parent_path() / name).string();
+}
+
+//! @brief @p s as a quoted JSON string
+std::string jsonString(const std::string& s)
+{
+    std::string quoted = "\"";
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\') { quoted += '\\'; }
+        if (static_cast<unsigned char>(c) < 0x20)
+        {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            quoted += escaped;
+        }
+        else { quoted += c; }
+    }
+    return quoted + "\"";
+}
+
+template<class T>
+void jsonArray(std::ostream& out, const std::vector<T>& values)
+{
+    out << '[';
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        out << (i ? "," : "") << values[i];
+    }
+    out << ']';
+}
+
+/*! @brief write the spectrum of one step in the selected format
+ *
+ * text: the shell index and normalized spectrum as two columns, one file per step in multi-step runs.
+ * jsonl: one JSON object per step, appended to @p outputFile.
+ * hdf5: one H5Part step per spectrum, appended to @p outputFile, with the arrays as datasets and the run parameters
+ *       and stage timings as step attributes.
+ * The structured formats hold all shells with their mode count, unnormalized power sum and the mean |k| of their bin.
+ * Shells merged into one bin share E = sum(powerSum) / sum(count) * 4 pi k^2 over the bin.
+ * With the Helmholtz split the solenoidal and compressive spectra follow E in every format.
+ * Custom shell edges are listed in the structured formats, text output labels those shells by their mean |k|.
+ * Cylindrical bins go to <stem>_cyl as k_par k_perp powerSum count rows, to a "cylindrical" object row-major over
+ * (k_par, k_perp) or to the 2D datasets powerSum, count and kPerp in the cylindrical group of the step. Like the
+ * shells, the text rows of custom shells are labelled by the mean k_perp of their modes and empty ones are left out.
+ */
+void writeSpectrum(const std::string& format, const std::string& outputFile, bool multiStep,
+                   const Mesh<MeshType>& mesh, const SpectrumInfo& info,
+                   const std::vector<std::pair<std::string, float>>& stages)
+{
+    if (format == "text")
+    {
+        std::ofstream file(stepOutputFile(outputFile, info.step, multiStep));
+        // integer shells are labelled by |k| and start at 1, custom shells by the mean |k| of their modes
+        bool customShells = !mesh.shellEdges_.empty();
+        for (int i = customShells ? 0 : 1; i < mesh.numShells_; i++)
+        {
+            if (customShells && mesh.shellCounts_[i] == 0) { continue; }
+            file << std::scientific << (customShells ? (double)mesh.shellK_[i] : (double)(i)) << " "
+                 << mesh.power_spectrum_[i];
+            if (mesh.helmholtzSplit_)
+            {
+                file << " " << mesh.solenoidalSpectrum_[i] << " " << mesh.compressiveSpectrum_[i];
+            }
+            file << "\n";
+        }
+
+        if (mesh.cylinderAxis_ >= 0)
+        {
+            std::ofstream cyl(stepOutputFile(cylinderOutputFile(outputFile), info.step, multiStep));
+            for (size_t b = 0; b < mesh.cylinderPower_.size(); b++)
+            {
+                if (customShells && mesh.cylinderCounts_[b] == 0) { continue; }
+                double kPerp = customShells ? (double)mesh.cylinderKPerp_[b] : (double)(b % mesh.numShells_);
+                cyl << std::scientific << (double)(b / mesh.numShells_) << " " << kPerp << " " << mesh.cylinderPower_[b]
+                    << " " << mesh.cylinderCounts_[b] << "\n";
+            }
+        }
+        return;
+    }
+
+    std::vector<int> shells(mesh.numShells_);
+    std::iota(shells.begin(), shells.end(), 0);
+
+    if (format == "jsonl")
+    {
+        std::ofstream out(outputFile, std::ios::app);
+        out << std::setprecision(std::numeric_limits<MeshType>::max_digits10);
+        out << "{\"step\":" << info.step << ",\"checkpoint\":" << jsonString(info.checkpoint)
+            << ",\"field\":" << jsonString(info.fieldMode) << ",\"interpolation\":" << jsonString(info.interpolationMode)
+            << ",\"numParticles\":" << info.numParticles << ",\"numRanks\":" << info.numRanks
+            << ",\"gridDim\":" << mesh.gridDim_ << ",\"numShells\":" << mesh.numShells_
+            << ",\"minBinCount\":" << mesh.shellMinCount_;
+        out << ",\"shell\":";
+        jsonArray(out, shells);
+        if (!mesh.shellEdges_.empty())
+        {
+            out << ",\"shellEdges\":";
+            jsonArray(out, mesh.shellEdges_);
+        }
+        out << ",\"k\":";
+        jsonArray(out, mesh.shellK_);
+        out << ",\"E\":";
+        jsonArray(out, mesh.power_spectrum_);
+        if (mesh.helmholtzSplit_)
+        {
+            out << ",\"Esolenoidal\":";
+            jsonArray(out, mesh.solenoidalSpectrum_);
+            out << ",\"Ecompressive\":";
+            jsonArray(out, mesh.compressiveSpectrum_);
+        }
+        out << ",\"count\":";
+        jsonArray(out, mesh.shellCounts_);
+        out << ",\"powerSum\":";
+        jsonArray(out, mesh.shellPower_);
+        if (mesh.cylinderAxis_ >= 0)
+        {
+            out << ",\"cylindrical\":{\"axis\":" << jsonString(std::string(1, "xyz"[mesh.cylinderAxis_]))
+                << ",\"numParallel\":" << mesh.gridDim_ / 2 + 1 << ",\"numPerp\":" << mesh.numShells_
+                << ",\"powerSum\":";
+            jsonArray(out, mesh.cylinderPower_);
+            out << ",\"count\":";
+            jsonArray(out, mesh.cylinderCounts_);
+            out << ",\"kPerp\":";
+            jsonArray(out, mesh.cylinderKPerp_);
+            out << "}";
+        }
+        out << ",\"timings\":{";
+        for (size_t i = 0; i < stages.size(); i++)
+        {
+            out << (i ? "," : "") << jsonString(stages[i].first) << ":" << stages[i].second;
+        }
+        out << "}}\n";
+        if (!out) { throw std::runtime_error("Could not append the spectrum to " + outputFile); }
+        return;
+    }
+
+    auto writer = makeH5PartWriter(MPI_COMM_SELF);
+    if (!writer) { throw std::runtime_error("The hdf5 output format requires HDF5 support"); }
+
+    writer->addStep(0, mesh.numShells_, outputFile);
+    writer->writeField("shell", shells.data(), 0);
+    writer->writeField("k", mesh.shellK_.data(), 0);
+    writer->writeField("E", mesh.power_spectrum_.data(), 0);
+    if (mesh.helmholtzSplit_)
+    {
+        writer->writeField("Esolenoidal", mesh.solenoidalSpectrum_.data(), 0);
+        writer->writeField("Ecompressive", mesh.compressiveSpectrum_.data(), 0);
+    }
+    writer->writeField("count", mesh.shellCounts_.data(), 0);
+    writer->writeField("powerSum", mesh.shellPower_.data(), 0);
+
+    auto stringAttribute = [&writer](const std::string& key, const std::string& value)
+    { writer->stepAttribute(key, value.data(), value.size()); };
+    stringAttribute("checkpoint", info.checkpoint);
+    stringAttribute("field", info.fieldMode);
+    stringAttribute("interpolation", info.interpolationMode);
+    writer->stepAttribute("step", &info.step, 1);
+    writer->stepAttribute("numParticles", &info.numParticles, 1);
+    writer->stepAttribute("numRanks", &info.numRanks, 1);
+    writer->stepAttribute("gridDim", &mesh.gridDim_, 1);
+    writer->stepAttribute("numShells", &mesh.numShells_, 1);
+    writer->stepAttribute("minBinCount", &mesh.shellMinCount_, 1);
+    if (!mesh.shellEdges_.empty())
+    {
+        writer->stepAttribute("shellEdges", mesh.shellEdges_.data(), mesh.shellEdges_.size());
+    }
+    if (mesh.cylinderAxis_ >= 0)
+    {
+        // the bins outgrow the attribute size limit from gridDim 256 on, they are datasets of their own
+        std::vector<uint64_t> shape{uint64_t(mesh.gridDim_ / 2 + 1), uint64_t(mesh.numShells_)};
+        writer->stepAttribute("cylinderAxis", &mesh.cylinderAxis_, 1);
+        writer->stepArray("cylindrical/powerSum", mesh.cylinderPower_.data(), shape);
+        writer->stepArray("cylindrical/count", mesh.cylinderCounts_.data(), shape);
+        writer->stepArray("cylindrical/kPerp", mesh.cylinderKPerp_.data(), shape);
+    }
+    for (const auto& [stage, seconds] : stages)
+    {
+        writer->stepAttribute("time " + stage, &seconds, 1);
+    }
+    writer->closeStep();
+}
+
+/*! @brief write the rasterized grid of all ranks' inboxes to an HDF5 file before it is transformed
+ *
+ * Velocities go to the datasets interpolated_vx/vy/vz read by scripts/power_spectra.py, density to "density" and
+ * sqrt(rho) v to sqrt_rho_vx/vy/vz.
+ */
+void writeGrid(Mesh<MeshType>& mesh, const std::string& path, const std::string& fieldMode, int step)
+{
+    const auto&             box = mesh.inbox_;
+    std::array<uint64_t, 3> globalSize{uint64_t(mesh.gridDim_), uint64_t(mesh.gridDim_), uint64_t(mesh.gridDim_)};
+    std::array<uint64_t, 3> low{uint64_t(box.low[0]), uint64_t(box.low[1]), uint64_t(box.low[2])};
+    std::array<uint64_t, 3> size{uint64_t(box.size[0]), uint64_t(box.size[1]), uint64_t(box.size[2])};
+
+    auto writer = makeH5GridWriter(MPI_COMM_WORLD, globalSize, low, size);
+    if (!writer) { throw std::runtime_error("Writing the grid requires HDF5 support"); }
+
+    mesh.copyGridToHost();
+    writer->addStep(0, mesh.velX_.size(), path);
+    if (fieldMode == "density") { writer->writeField("density", mesh.density_.data(), 0); }
+    else
+    {
+        std::string prefix = fieldMode == "velocity" ? "interpolated_v" : "sqrt_rho_v";
+        writer->writeField(prefix + "x", mesh.velX_.data(), 0);
+        writer->writeField(prefix + "y", mesh.velY_.data(), 0);
+        writer->writeField(prefix + "z", mesh.velZ_.data(), 0);
+    }
+    int stepAttr = step;
+    writer->fileAttribute("gridDim", &mesh.gridDim_, 1);
+    writer->fileAttribute("step", &stepAttr, 1);
+    writer->closeStep();
+}
+
+//! @brief absolute path, size and modification time of @p checkpoint, changes whenever the file is rewritten
+std::string checkpointIdentity(const std::string& checkpoint)
+{
+    std::error_code   ec;
+    std::stringstream id;
+    id << std::filesystem::absolute(checkpoint, ec).string() << '|' << std::filesystem::file_size(checkpoint, ec)
+       << '|' << std::filesystem::last_write_time(checkpoint, ec).time_since_epoch().count();
+    return id.str();
+}
+
+//! @brief particle count of @p step in @p checkpoint, 0 if it cannot be read
+uint64_t checkpointNumParticles(const std::string& checkpoint, int step)
+{
+    try
+    {
+        auto reader = makeH5PartReader(MPI_COMM_SELF);
+        reader->setStep(checkpoint, step, FileMode::independent);
+        uint64_t numGlobal = reader->globalNumParticles();
+        reader->closeStep();
+        return numGlobal;
+    }
+    catch (const std::exception&)
+    {
+        return 0;
+    }
+}
+
+/*! @brief whether the cache step directory @p stepDir was written from the current version of @p checkpoint
+ *
+ * The checkpoint file in @p stepDir records the identity and particle count of the checkpoint step it was taken from.
+ * Both have to match the checkpoint as it is now and the count also @p numGlobal, the count the cache itself holds.
+ */
+bool checkpointMatches(const std::string& stepDir, const std::string& checkpoint, int step, uint64_t numGlobal)
+{
+    std::ifstream in(stepDir + "/checkpoint");
+    std::string   identity, key;
+    uint64_t      storedNumGlobal = 0;
+    std::getline(in, identity);
+    in >> key >> storedNumGlobal;
+    return bool(in) && identity == checkpointIdentity(checkpoint) && storedNumGlobal == numGlobal &&
+           storedNumGlobal == checkpointNumParticles(checkpoint, step);
+}
+
+//! @brief record the identity of @p checkpoint in @p stepDir, written last so that an interrupted write misses
+void writeCheckpointMatch(const std::string& stepDir, const std::string& checkpoint, uint64_t numGlobal)
+{
+    {
+        std::ofstream out(stepDir + "/checkpoint.tmp");
+        out << checkpointIdentity(checkpoint) << "\nnumGlobal " << numGlobal << "\n";
+    }
+    std::filesystem::rename(stepDir + "/checkpoint.tmp", stepDir + "/checkpoint");
+}
+
+/*! @brief name of the grid cache entry of a checkpoint step rasterized with the given settings
+ *
+ * The FNV-1a hash covers everything that determines the local inbox grids: the checkpoint, including its size and
+ * modification time so that a rewritten file misses, the step, the grid size, the rasterization mode, the particle
+ * precision and the decomposition.
+ */
+std::string gridCacheKey(const std::string& checkpoint, int step, int gridSize, const std::string& interpolationMode,
+                         const std::string& fieldMode, int numRanks, bool usePencils,
+                         const std::array<int, 3>& procGrid)
+{
+    std::stringstream id;
+    id << checkpointIdentity(checkpoint) << '|' << step << '|' << gridSize << '|' << interpolationMode << '|'
+       << fieldMode << '|' << sizeof(ParticleType) << '|' << sizeof(MeshType) << '|' << numRanks << '|' << usePencils
+       << '|' << procGrid[0] << 'x' << procGrid[1] << 'x' << procGrid[2];
+
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : id.str())
+    {
+        hash = (hash ^ c) * 1099511628211ull;
+    }
+    std::stringstream hex;
+    hex << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return hex.str();
+}
+
+//! @brief grid cache file header, followed by the inbox velX, velY and velZ grids, or velX only for scalar fields
+struct GridCacheHeader
+{
+    uint64_t magic;
+    uint64_t numGlobal;
+    uint64_t inboxSize;
+};
+
+constexpr uint64_t gridCacheMagic = 0x4752494443414348ull; // "GRIDCACH"
+
+std::string gridCacheFile(const std::string& entry, int rank) { return entry + "/rank_" + std::to_string(rank); }
+
+//! @brief whether all ranks have their grids of @p entry, if so @p numGlobal is set to the step's particle count
+bool gridCacheHit(const std::string& entry, int rank, uint64_t& numGlobal)
+{
+    GridCacheHeader header{};
+    std::ifstream   in(gridCacheFile(entry, rank), std::ios::binary);
+    int             hit = in.read(reinterpret_cast<char*>(&header), sizeof(header)) && header.magic == gridCacheMagic;
+    MPI_Allreduce(MPI_IN_PLACE, &hit, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+    if (hit) { numGlobal = header.numGlobal; }
+    return hit;
+}
+
+std::vector<std::vector<MeshType>*> cachedGrids(Mesh<MeshType>& mesh)
+{
+    if (mesh.scalarField_) { return {&mesh.velX_}; }
+    return {&mesh.velX_, &mesh.velY_, &mesh.velZ_};
+}
+
+void loadGridCache(const std::string& entry, Mesh<MeshType>& mesh)
+{
+    GridCacheHeader header{};
+    std::ifstream   in(gridCacheFile(entry, mesh.rank_), std::ios::binary);
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (header.inboxSize != mesh.velX_.size()) { throw std::runtime_error("Grid cache entry does not match the mesh"); }
+    for (auto* grid : cachedGrids(mesh))
+    {
+        in.read(reinterpret_cast<char*>(grid->data()), grid->size() * sizeof(MeshType));
+    }
+    if (!in) { throw std::runtime_error("Could not read grid cache entry " + entry); }
+#ifdef USE_CUDA
+    mesh.gpuDataValid_ = false;
+#endif
+}
+
+//! @brief store the rasterized inbox grids, written under a temporary name and renamed to never expose partial files
+void storeGridCache(const std::string& entry, Mesh<MeshType>& mesh, uint64_t numGlobal)
+{
+    mesh.copyGridToHost();
+    std::filesystem::create_directories(entry);
+
+    std::string     path = gridCacheFile(entry, mesh.rank_);
+    GridCacheHeader header{gridCacheMagic, numGlobal, mesh.velX_.size()};
+    {
+        std::ofstream out(path + ".tmp", std::ios::binary);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (auto* grid : cachedGrids(mesh))
+        {
+            out.write(reinterpret_cast<const char*>(grid->data()), grid->size() * sizeof(MeshType));
+        }
+        if (!out) { throw std::runtime_error("Could not write grid cache entry " + entry); }
+    }
+    std::filesystem::rename(path + ".tmp", path);
+}
+
+//! @brief text spectrum file of a coarse grid, the grid size is appended to the file name stem
+std::string gridSizeOutputFile(const std::string& outputFile, int gridDim)
+{
+    std::filesystem::path path(outputFile);
+    std::string           name = path.stem().string() + "_g" + std::to_string(gridDim) + path.extension().string();
+    return (path.parent_path() / name).string();
+}
+
+//! @brief text file of the cylindrical bins next to the text spectrum @p outputFile
+std::string cylinderOutputFile(const std::string& outputFile)
+{
+    std::filesystem::path path(outputFile);
+    std::string           name = path.stem().string() + "_cyl" + path.extension().string();
+    return (path.parent_path() / name).string();
+}
+
+//! @brief text spectrum or grid file of one of several fields, the field name is appended to the file name stem
+std::string fieldOutputFile(const std::string& outputFile, const std::string& fieldMode)
+{
+    std::filesystem::path path(outputFile);
+    std::string           name = path.stem().string() + "_" + fieldMode + path.extension().string();
+    return (path.parent_path() / name).string();
+}
+
+//! @brief rasterize the particle density of a synced step into mesh.density_ with the selected backend
+void rasterizeDensity(Mesh<MeshType>& mesh, RasterBackend backend, StepParticles& particles, int powerDim)
+{
+    std::vector<uint64_t>&     keys = particles.keys;
+    std::vector<ParticleType>& x    = particles.x;
+    std::vector<ParticleType>& y    = particles.y;
+    std::vector<ParticleType>& z    = particles.z;
+
+    if (mesh.rank_ == 0) std::cout << "Using density rasterization" << std::endl;
+    if (backend == RasterBackend::Cuda)
+    {
 #ifdef USE_CUDA
-        mesh.gpuDataValid_ = false;
+        rasterize_particles_to_density_cuda(mesh, keys, x, y, z, powerDim);
+#else
+        mesh.rasterize_particles_to_density(keys, x, y, z, powerDim);
 #endif
     }
-    else if (interpolationMode == "sph")
+    else
+    {
+        if (backend == RasterBackend::Nvshmem && mesh.rank_ == 0)
+            std::cout << "NVSHMEM density rasterizer is not implemented, using CPU/MPI density path." << std::endl;
+        mesh.rasterize_particles_to_density(keys, x, y, z, powerDim);
+    }
+}
+
+//! @brief rasterize the particle velocities of a synced step into mesh.velX_/Y_/Z_ with the selected interpolation
+void rasterizeVelocity(Mesh<MeshType>& mesh, RasterBackend backend, const std::string& interpolationMode,
+                       StepParticles& particles, int powerDim)
+{
+    std::vector<uint64_t>&     keys = particles.keys;
+    std::vector<ParticleType>& x    = particles.x;
+    std::vector<ParticleType>& y    = particles.y;
+    std::vector<ParticleType>& z    = particles.z;
+    std::vector<ParticleType>& h    = particles.h;
+    std::vector<ParticleType>& vx   = particles.vx;
+    std::vector<ParticleType>& vy   = particles.vy;
+    std::vector<ParticleType>& vz   = particles.vz;
+    int                        rank = mesh.rank_;
+
+    if (interpolationMode == "sph")
     {
         if (rank == 0) std::cout << "Using SPH interpolation" << std::endl;
         if (backend == RasterBackend::Cuda)
@@ -309,35 +1563,95 @@ int main(int argc, char** argv)
             mesh.rasterize_particles_to_mesh(keys, x, y, z, vx, vy, vz, powerDim);
         }
     }
+}
+
+//! @brief turn the rasterized velocity grid into sqrt(rho) v, whose spectrum integrates to the kinetic energy
+void weightBySqrtDensity(Mesh<MeshType>& mesh)
+{
+    mesh.copyGridToHost();
+#pragma omp parallel for
+    for (size_t i = 0; i < mesh.velX_.size(); i++)
+    {
+        MeshType w = std::sqrt(mesh.density_[i]);
+        mesh.velX_[i] *= w;
+        mesh.velY_[i] *= w;
+        mesh.velZ_[i] *= w;
+    }
+#ifdef USE_CUDA
+    mesh.gpuDataValid_ = false;
+#endif
+}
 
-    // mesh.rasterize_using_cornerstone(keys, x, y, z, vx, vy, vz, powerDim);
-    std::cout << "rasterized" << std::endl;
-    timer.elapsed("Rasterization");
-    // calculate power spectrum
-    mesh.calculate_power_spectrum();
-    timer.elapsed("Power Spectrum");
+/*! @brief rasterize the open checkpoint step in blocks of at most @p blockSize local particles
+ *
+ * Only one block of the fields needed by the selected mode is resident at a time. Particles are rasterized in file
+ * order without a domain sync, their keys are computed per block.
+ */
+void streamRasterize(IFileReader& reader, Mesh<MeshType>& mesh, const std::string& fieldMode,
+                     const std::string& interpolationMode, uint64_t blockSize, int powerDim)
+{
+    using KeyType = uint64_t;
 
-    // write power spectrum to HDF5?
-    if (rank == 0)
+    // rasterizers are collective, all ranks run the same number of blocks
+    uint64_t localCount = reader.localNumParticles();
+    uint64_t numBlocks  = (localCount + blockSize - 1) / blockSize;
+    MPI_Allreduce(MPI_IN_PLACE, &numBlocks, 1, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD);
+
+    bool density = fieldMode == "density";
+    bool sph     = !density && interpolationMode == "sph";
+    bool cellAvg = !density && interpolationMode == "cell_avg";
+
+    cstone::Box<ParticleType> box(-0.5, 0.5, cstone::BoundaryType::periodic);
+    std::vector<KeyType>      keys;
+    std::vector<ParticleType> x, y, z, h, vx, vy, vz;
+
+    std::vector<std::string>                          fields = rasterFields(fieldMode, interpolationMode);
+    std::map<std::string, std::vector<ParticleType>*> buffers{{"x", &x},   {"y", &y},   {"z", &z},  {"h", &h},
+                                                              {"vx", &vx}, {"vy", &vy}, {"vz", &vz}};
+
+    mesh.beginBlocks();
+    for (uint64_t block = 0; block < numBlocks; block++)
     {
-        // write power spectrum to file mesh.power_spectrum_ vector has the normalized data
-        std::ofstream file(outputFile);
-        for (size_t i = 1; i < mesh.numShells_; i++)
+        uint64_t first = std::min(block * blockSize, localCount);
+        uint64_t last  = std::min(first + blockSize, localCount);
+        size_t   n     = last - first;
+
+        for (const auto& field : fields)
+        {
+            buffers.at(field)->resize(n);
+        }
+        // reads are collective, ranks without particles left read empty blocks
+        reader.setLocalView(first, last);
+        for (const auto& field : fields)
         {
-            file << std::scientific << (double)(i) << " " << mesh.power_spectrum_[i] << std::endl;
+            reader.readField(field, buffers.at(field)->data());
         }
-        file.close();
+
+        keys.assign(n, KeyType(0));
+        cstone::computeSfcKeys(x.data(), y.data(), z.data(), cstone::sfcKindPointer(keys.data()), n, box);
+
+        if (density) { mesh.rasterize_particles_to_density(keys, x, y, z, powerDim); }
+        else if (sph) { mesh.rasterize_particles_to_mesh_sph(keys, x, y, z, vx, vy, vz, h, powerDim); }
+        else if (cellAvg) { mesh.rasterize_particles_to_mesh_cell_avg(keys, x, y, z, vx, vy, vz, powerDim); }
+        else { mesh.rasterize_particles_to_mesh(keys, x, y, z, vx, vy, vz, powerDim); }
     }
+    mesh.endBlocks();
 
-    int exitCode = exitSuccess();
-#ifdef USE_NVSHMEM
-    if (backend == RasterBackend::Nvshmem)
+    if (density)
     {
-        nvshmem_barrier_all();
-        nvshmem_finalize();
+        mesh.finalizeDensityFromMass();
+        mesh.velX_ = mesh.density_;
+    }
+    else if (sph) { mesh.normalizeSphVelocities(); }
+    else if (cellAvg)
+    {
+        mesh.finalizeCellAverages();
+        mesh.extrapolateEmptyCellsFromNeighbors();
     }
+    else { mesh.extrapolateEmptyCellsFromNeighbors(); }
+#ifdef USE_CUDA
+    mesh.gpuDataValid_ = false;
 #endif
-    return exitCode;
 }
 
 void printSpectrumHelp(char* name, int rank)
@@ -356,10 +1670,52 @@ void printSpectrumHelp(char* name, int rank)
         printf("\t--backend \t\t Rasterization backend: 'cpu', 'cuda' (or 'gpudirect'), 'nvshmem',"
                " or omit for automatic selection (prefers nvshmem, then cuda, then cpu).\n\n");
         printf("\t--interpolation \t\t Interpolation method: 'nearest' (default), 'sph', or 'cell_avg'.\n\n");
-        printf("\t--field \t\t Particle-to-grid field: 'velocity' (default) or 'density'.\n\n");
+        printf("\t--field \t\t Particle-to-grid fields, comma separated: 'velocity' (default), 'density' or"
+               " 'sqrt_rho_velocity'. Several fields share one read and sync and get one spectrum each, text output"
+               " goes to <stem>_<field>.\n\n");
         printf("\t--output \t\t Output filename for the power spectrum (default: power_spectrum.txt).\n\n");
         printf("\t--pencils \t\t Use heFFTe pencil decomposition instead of the default slab decomposition.\n\n");
         printf("\t--cuda-aware-mpi \t Enable CUDA-aware MPI Alltoallv exchange path in CUDA nearest/cell_avg/SPH rasterizers.\n\n");
         printf("\t--cuda-aware-full-pack \t Enable full GPU rank-pack send path for CUDA-aware mode (experimental).\n\n");
+        printf("\t--compress-indices \t Delta/varint-encode the cell index streams of the host-side rasterizer exchanges.\n\n");
+        printf("\t--sparse-exchange \t Exchange rasterizer data point-to-point with nonzero peers only instead of MPI_Alltoallv.\n\n");
+        printf("\t--overlap-exchange \t Deposit local particles while the remote rasterizer records are in flight.\n\n");
+        printf("\t--subgrid-reshape \t Deposit 'sph', 'cell_avg' and density into a local subgrid and sum it into the FFT boxes.\n\n");
+        printf("\t--exchange-budget-mb \t Exchange 'nearest', 'cell_avg' and density records in rounds of at most this many MB per rank.\n\n");
+        printf("\t--steps \t\t Steps to process in one run: comma separated steps and ranges first:last[:stride], e.g."
+               " '0:100:10,150'. The mesh and FFT plan are reused across steps. Not combined with --numSteps.\n\n");
+        printf("\t--numSteps \t\t Number of consecutive checkpoint steps to process, starting at --stepNo. Each step is written to"
+               " the output file name with '_<step>' appended.\n\n");
+        printf("\t--prefetch \t\t Read the next step on a background thread while the current one is processed (needs"
+               " MPI_THREAD_MULTIPLE and a thread-safe HDF5 library).\n\n");
+        printf("\t--io-hints \t\t MPI-IO hints for reading the checkpoint as comma separated key=value pairs, e.g."
+               " 'romio_cb_read=enable,cb_buffer_size=16777216'.\n\n");
+        printf("\t--io-aggregators \t Read with collective buffering on this many aggregators (cb_nodes).\n\n");
+        printf("\t--io-align-bytes \t Align the per-rank particle ranges to multiples of this many bytes, e.g. the file"
+               " stripe size.\n\n");
+        printf("\t--raw-cache [dir] \t Keep the read fields of each step in a columnar raw sidecar (default"
+               " <checkpoint>.raw) and map them from there in later runs instead of reading the checkpoint.\n\n");
+        printf("\t--sync-cache [dir] \t Store the particles after the domain sync (default <checkpoint>.synced) and"
+               " load them from there on re-runs with the same number of ranks, skipping the read and the sync.\n\n");
+        printf("\t--output-format \t text (default): two columns per step. jsonl or hdf5: append one record per step"
+               " to --output with k, E(k), shell counts, power sums, run parameters and stage timings.\n\n");
+        printf("\t--coarse-grids \t Comma separated grid sizes dividing --gridSize. Their spectra are computed in the"
+               " same run from the rasterized grid, averaged down to each size. Text output goes to <stem>_g<size>.\n\n");
+        printf("\t--helmholtz \t\t Split the velocity spectrum into its solenoidal and compressive parts from the same"
+               " FFTs. Adds the columns Esol Ecomp to text output and Esolenoidal, Ecompressive to jsonl and hdf5.\n\n");
+        printf("\t--shell-edges \t\t Shells of the spectrum as 'log:kmin:kmax:numShells' or a comma separated list of"
+               " ascending |k| edges, instead of --numShells integer shells. Modes outside the edges are not binned.\n\n");
+        printf("\t--cylindrical \t\t x, y or z: also bin the spectrum over (k_par, k_perp) about this axis. Text output"
+               " goes to <stem>_cyl with k_par k_perp powerSum count rows.\n\n");
+        printf("\t--tune-fft \t\t Benchmark processor grids, slabs/pencils, reordering and reshape algorithms for"
+               " --gridSize (and --coarse-grids) on this many ranks, store the fastest in the tuning file and exit.\n\n");
+        printf("\t--fft-tuning \t\t Tuning file written by --tune-fft and read by normal runs (default fft_tuning.txt)."
+               " Grid sizes and rank counts without an entry use the min-surface grid and heFFTe defaults.\n\n");
+        printf("\t--grid-output \t\t Also write the rasterized grid to this HDF5 file, with one (z, y, x) dataset per"
+               " velocity component or the density.\n\n");
+        printf("\t--grid-cache [dir] \t Keep the rasterized grids of each step (default <checkpoint>.gridcache), keyed"
+               " by checkpoint, step, grid size, mode and rank count. Re-runs that hit skip read, sync and"
+               " rasterization.\n\n");
+        printf("\t--stream-block \t Read and rasterize the checkpoint in blocks of this many particles per rank, skipping the domain sync.\n\n");
     }
 }
\ No newline at end of file
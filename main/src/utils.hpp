@@ -3,12 +3,17 @@
 #include <tuple>
 #include <omp.h>
 #include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
 
-auto initMpi()
+//! @brief initialize MPI with at least @p threadLevel thread support if the library provides it
+auto initMpi(int threadLevel = MPI_THREAD_SINGLE)
 {
     int rank     = 0;
     int numRanks = 0;
-    MPI_Init(NULL, NULL);
+    int provided = 0;
+    MPI_Init_thread(NULL, NULL, threadLevel, &provided);
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &numRanks);
     if (rank == 0)
@@ -51,18 +56,26 @@ public:
     void start()
     {
         tstart = tlast = Clock::now();
+        stages_.clear();
     }
 
     //! @brief time elapsed between tstart and now
     void elapsed(const std::string func) 
     {
         tlast = Clock::now();
-        out << func << " elapsed time: " << std::chrono::duration_cast<Time>(tlast - tstart).count() << std::endl;
+        float seconds = std::chrono::duration_cast<Time>(tlast - tstart).count();
+        out << func << " elapsed time: " << seconds << std::endl;
+        stages_.emplace_back(func, seconds);
         tstart = tlast;
     }
 
+    //! @brief the stages reported with elapsed() since start(), in seconds
+    const std::vector<std::pair<std::string, float>>& stages() const { return stages_; }
+
 
 private:
     std::ostream&                  out;
     std::chrono::time_point<Clock> tstart, tlast;
+
+    std::vector<std::pair<std::string, float>> stages_;
 };
@@ -196,4 +196,829 @@ TEST(meshTest, testCalculateRankFromMeshCoord)
             }
         }
     }
-}
\ No newline at end of file
+}
+
+TEST(meshTest, testExtrapolateEmptyCells)
+{
+    int rank = 0, numRanks = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numRanks);
+
+    int          gridSize  = 4;
+    int          numShells = gridSize / 2;
+    Mesh<double> mesh(rank, numRanks, gridSize, numShells);
+
+    // Fill every local cell with its index except cell 0, which is left empty (infinite distance).
+    std::iota(mesh.velX_.begin(), mesh.velX_.end(), 0);
+    std::iota(mesh.velY_.begin(), mesh.velY_.end(), 0);
+    std::iota(mesh.velZ_.begin(), mesh.velZ_.end(), 0);
+    std::fill(mesh.distance_.begin(), mesh.distance_.end(), 0.0);
+    mesh.distance_[0] = std::numeric_limits<double>::infinity();
+    mesh.velX_[0]     = -1.0;
+
+    // expected: average of the filled neighbors of local cell (0,0,0)
+    int    sx = mesh.inbox_.size[0], sy = mesh.inbox_.size[1], sz = mesh.inbox_.size[2];
+    double sum   = 0;
+    int    count = 0;
+    for (int i = 0; i < std::min(2, sz); i++)
+        for (int j = 0; j < std::min(2, sy); j++)
+            for (int k = 0; k < std::min(2, sx); k++)
+            {
+                int index = (i * sy + j) * sx + k;
+                if (index == 0) continue;
+                sum += index;
+                count++;
+            }
+
+    mesh.extrapolateEmptyCellsFromNeighbors();
+
+    if (count > 0)
+    {
+        EXPECT_NEAR(mesh.velX_[0], sum / count, 1e-12);
+        EXPECT_NEAR(mesh.velY_[0], sum / count, 1e-12);
+        EXPECT_NEAR(mesh.velZ_[0], sum / count, 1e-12);
+    }
+    // filled cells are untouched
+    for (size_t i = 1; i < mesh.velX_.size(); i++)
+    {
+        EXPECT_EQ(mesh.velX_[i], double(i));
+    }
+}
+
+TEST(meshTest, testDensityRasterization)
+{
+    int rank = 0, numRanks = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numRanks);
+
+    int          gridSize  = 4;
+    int          numShells = gridSize / 2;
+    Mesh<double> mesh(rank, numRanks, gridSize, numShells);
+
+    // Three particles in global cell (0,0,0) on every rank; remote ranks ship them as a single aggregated record.
+    std::vector<KeyType> keys = {0, 0, 0};
+    std::vector<double>  x    = {-0.45, -0.45, -0.45};
+    std::vector<double>  y    = {-0.45, -0.45, -0.45};
+    std::vector<double>  z    = {-0.45, -0.45, -0.45};
+
+    mesh.rasterize_particles_to_density(keys, x, y, z, /*powerDim=*/2);
+
+    if (rank == 0)
+    {
+        double cellVol = std::pow(1.0 / gridSize, 3);
+        EXPECT_NEAR(mesh.massSum_[0], 3.0 * numRanks, 1e-12);
+        EXPECT_NEAR(mesh.density_[0], 3.0 * numRanks / cellVol, 1e-9);
+    }
+    else { EXPECT_EQ(mesh.send_index_density.size(), 1); }
+}
+
+TEST(meshTest, testIndexStreamCodec)
+{
+    // two destination ranks: an ascending run with small gaps and an unsorted segment with large jumps
+    std::vector<uint32_t> indices = {5, 6, 7, 9, 200, 3, 4000000000u, 0, 17};
+    std::vector<int>      count   = {5, 4};
+    std::vector<int>      disp    = {0, 5, 9};
+
+    std::vector<uint8_t> bytes;
+    std::vector<int>     byteCount, byteDisp;
+    encodeIndexStreams(indices, count, disp, bytes, byteCount, byteDisp);
+
+    // the ascending segment needs one byte per index except for the jump to 200
+    EXPECT_EQ(byteCount[0], 6);
+    EXPECT_EQ(byteDisp[2], int(bytes.size()));
+
+    std::vector<uint32_t> decoded(indices.size());
+    decodeIndexStreams(bytes, byteDisp, count, disp, decoded);
+    EXPECT_EQ(decoded, indices);
+}
+
+TEST(meshTest, testCellAvgRasterizationCompressedIndices)
+{
+    int rank = 0, numRanks = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numRanks);
+
+    int          gridSize  = 4;
+    int          numShells = gridSize / 2;
+    Mesh<double> mesh(rank, numRanks, gridSize, numShells);
+    mesh.compressIndexExchange_ = true;
+
+    // particles in global cells (0,0,0) and (3,3,3), each owned by the first and last rank respectively
+    KeyType              farKey = cstone::iHilbert<KeyType>(3 * 524289, 3 * 524289, 3 * 524289);
+    std::vector<KeyType> keys   = {0, 0, farKey};
+    std::vector<double>  x(3, 0.0), y(3, 0.0), z(3, 0.0);
+    std::vector<double>  vx = {1.0, 3.0, 5.0};
+    std::vector<double>  vy = {2.0, 4.0, 6.0};
+    std::vector<double>  vz = {0.0, 6.0, 7.0};
+
+    mesh.rasterize_particles_to_mesh_cell_avg(keys, x, y, z, vx, vy, vz, /*powerDim=*/2);
+
+    if (mesh.calculateRankFromMeshCoord(0, 0, 0) == rank)
+    {
+        uint32_t idx = mesh.calculateInboxIndexFromMeshCoord(0, 0, 0);
+        EXPECT_NEAR(mesh.velX_[idx], 2.0, 1e-12);
+        EXPECT_NEAR(mesh.velY_[idx], 3.0, 1e-12);
+        EXPECT_NEAR(mesh.velZ_[idx], 3.0, 1e-12);
+    }
+    if (mesh.calculateRankFromMeshCoord(3, 3, 3) == rank)
+    {
+        uint32_t idx = mesh.calculateInboxIndexFromMeshCoord(3, 3, 3);
+        EXPECT_NEAR(mesh.velX_[idx], 5.0, 1e-12);
+        EXPECT_NEAR(mesh.velY_[idx], 6.0, 1e-12);
+        EXPECT_NEAR(mesh.velZ_[idx], 7.0, 1e-12);
+    }
+}
+
+TEST(meshTest, testSparseExchange)
+{
+    int rank = 0, numRanks = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numRanks);
+
+    // ring pattern: every rank sends rank + 1 indices to its right neighbor only
+    int              right = (rank + 1) % numRanks;
+    int              left  = (rank + numRanks - 1) % numRanks;
+    std::vector<int> sendCount(numRanks, 0), recvCount(numRanks, -1);
+    std::vector<int> sendDisp(numRanks + 1, 0), recvDisp(numRanks + 1, 0);
+    sendCount[right] = rank + 1;
+    for (int i = 0; i < numRanks; i++)
+    {
+        sendDisp[i + 1] = sendDisp[i] + sendCount[i];
+    }
+
+    exchangeCounts(sendCount, recvCount, true, MPI_COMM_WORLD);
+    for (int i = 0; i < numRanks; i++)
+    {
+        EXPECT_EQ(recvCount[i], i == left ? left + 1 : 0);
+        recvDisp[i + 1] = recvDisp[i] + recvCount[i];
+    }
+
+    std::vector<uint32_t> sendIndex(sendDisp[numRanks]), recvIndex(recvDisp[numRanks]);
+    std::iota(sendIndex.begin(), sendIndex.end(), 100 * rank);
+    for (bool compress : {false, true})
+    {
+        std::fill(recvIndex.begin(), recvIndex.end(), 0);
+        exchangeIndices(sendIndex, sendCount, sendDisp, recvIndex, recvCount, recvDisp, compress, true,
+                        MPI_COMM_WORLD);
+        for (int j = 0; j < recvDisp[numRanks]; j++)
+        {
+            EXPECT_EQ(recvIndex[j], uint32_t(100 * left + j));
+        }
+    }
+}
+
+TEST(meshTest, testOverlapExchangeMatchesBlocking)
+{
+    int rank = 0, numRanks = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numRanks);
+
+    int gridSize  = 4;
+    int numShells = gridSize / 2;
+
+    // one particle per cell and rank, slightly offset per rank so that nearest-neighbor winners are unique
+    std::vector<KeyType> keys;
+    std::vector<double>  x, y, z, vx, vy, vz, h;
+    for (int i = 0; i < gridSize; i++)
+        for (int j = 0; j < gridSize; j++)
+            for (int k = 0; k < gridSize; k++)
+            {
+                double offset = 0.01 * (rank + 1);
+                keys.push_back(cstone::iHilbert<KeyType>(i * 524289, j * 524289, k * 524289));
+                x.push_back(-0.5 + (i + 0.5) / gridSize + offset);
+                y.push_back(-0.5 + (j + 0.5) / gridSize + offset);
+                z.push_back(-0.5 + (k + 0.5) / gridSize + offset);
+                vx.push_back(i + 10.0 * rank);
+                vy.push_back(j + 10.0 * rank);
+                vz.push_back(k + 10.0 * rank);
+                h.push_back(0.2);
+            }
+
+    Mesh<double> blocking(rank, numRanks, gridSize, numShells);
+    Mesh<double> overlap(rank, numRanks, gridSize, numShells);
+    overlap.overlapExchange_       = true;
+    overlap.compressIndexExchange_ = true;
+
+    blocking.rasterize_particles_to_mesh(keys, x, y, z, vx, vy, vz, 2);
+    overlap.rasterize_particles_to_mesh(keys, x, y, z, vx, vy, vz, 2);
+    EXPECT_EQ(blocking.velX_, overlap.velX_);
+
+    blocking.rasterize_particles_to_mesh_cell_avg(keys, x, y, z, vx, vy, vz, 2);
+    overlap.rasterize_particles_to_mesh_cell_avg(keys, x, y, z, vx, vy, vz, 2);
+    EXPECT_EQ(blocking.cellCount_, overlap.cellCount_);
+
+    blocking.rasterize_particles_to_density(keys, x, y, z, 2);
+    overlap.rasterize_particles_to_density(keys, x, y, z, 2);
+    for (size_t i = 0; i < blocking.massSum_.size(); i++)
+    {
+        EXPECT_NEAR(blocking.massSum_[i], overlap.massSum_[i], 1e-12);
+    }
+
+    blocking.rasterize_particles_to_mesh_sph(keys, x, y, z, vx, vy, vz, h, 2);
+    overlap.rasterize_particles_to_mesh_sph(keys, x, y, z, vx, vy, vz, h, 2);
+    for (size_t i = 0; i < blocking.weightSum_.size(); i++)
+    {
+        EXPECT_NEAR(blocking.weightSum_[i], overlap.weightSum_[i], 1e-9);
+        EXPECT_NEAR(blocking.velY_[i], overlap.velY_[i], 1e-9);
+    }
+}
+
+TEST(meshTest, testSubgridReshapeMatchesRecordExchange)
+{
+    int rank = 0, numRanks = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numRanks);
+
+    int gridSize  = 4;
+    int numShells = gridSize / 2;
+
+    // each rank holds a compact half of the grid plus one particle in the opposite corner
+    std::vector<KeyType> keys;
+    std::vector<double>  x, y, z, vx, vy, vz, h;
+    auto addParticle = [&](int i, int j, int k)
+    {
+        keys.push_back(cstone::iHilbert<KeyType>(i * 524289, j * 524289, k * 524289));
+        x.push_back(-0.5 + (i + 0.5) / gridSize);
+        y.push_back(-0.5 + (j + 0.5) / gridSize);
+        z.push_back(-0.5 + (k + 0.5) / gridSize);
+        vx.push_back(i + rank);
+        vy.push_back(j * rank);
+        vz.push_back(k - rank);
+        h.push_back(0.15);
+    };
+    for (int i = 0; i < gridSize / 2; i++)
+        for (int j = 0; j < gridSize; j++)
+            for (int k = 0; k < gridSize; k++)
+            {
+                addParticle(rank % 2 == 0 ? i : gridSize - 1 - i, j, k);
+            }
+    addParticle(gridSize - 1, gridSize - 1, gridSize - 1);
+
+    Mesh<double> records(rank, numRanks, gridSize, numShells);
+    Mesh<double> subgrid(rank, numRanks, gridSize, numShells);
+    subgrid.subgridReshape_ = true;
+
+    records.rasterize_particles_to_density(keys, x, y, z, 2);
+    subgrid.rasterize_particles_to_density(keys, x, y, z, 2);
+    for (size_t i = 0; i < records.massSum_.size(); i++)
+    {
+        EXPECT_NEAR(records.massSum_[i], subgrid.massSum_[i], 1e-12);
+    }
+
+    records.rasterize_particles_to_mesh_cell_avg(keys, x, y, z, vx, vy, vz, 2);
+    subgrid.rasterize_particles_to_mesh_cell_avg(keys, x, y, z, vx, vy, vz, 2);
+    EXPECT_EQ(records.cellCount_, subgrid.cellCount_);
+    for (size_t i = 0; i < records.velX_.size(); i++)
+    {
+        EXPECT_NEAR(records.velX_[i], subgrid.velX_[i], 1e-12);
+    }
+
+    records.rasterize_particles_to_mesh_sph(keys, x, y, z, vx, vy, vz, h, 2);
+    subgrid.rasterize_particles_to_mesh_sph(keys, x, y, z, vx, vy, vz, h, 2);
+    for (size_t i = 0; i < records.weightSum_.size(); i++)
+    {
+        EXPECT_NEAR(records.weightSum_[i], subgrid.weightSum_[i], 1e-9);
+        EXPECT_NEAR(records.velZ_[i], subgrid.velZ_[i], 1e-9);
+    }
+}
+
+TEST(meshTest, testSubgridBoxesFollowDestinations)
+{
+    int rank = 0, numRanks = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numRanks);
+
+    // a rank deposits into all cells of its own inbox and into the first cell of the next rank's inbox
+    int                 gridSize = 8;
+    Mesh<double>        mesh(rank, numRanks, gridSize, gridSize / 2);
+    std::vector<double> target(mesh.inbox_.count(), 0.0);
+    auto                sg   = mesh.beginSubgrids({target.data()});
+    int                 next = (rank + 1) % numRanks;
+    auto                own = mesh.inbox_, far = sg.inboxes[next];
+
+    mesh.addSubgridCells(sg, own.low, own.high);
+    mesh.addSubgridCells(sg, far.low, far.low);
+    mesh.allocateSubgrids(sg);
+    for (int r = 0; r < numRanks; r++)
+    {
+        EXPECT_EQ(sg.count[r], r == next && next != rank ? 1 : 0);
+    }
+
+    for (int k = own.low[2]; k <= own.high[2]; k++)
+        for (int j = own.low[1]; j <= own.high[1]; j++)
+            for (int i = own.low[0]; i <= own.high[0]; i++)
+            {
+                mesh.depositSubgrid<1>(sg, i, j, k, {1.0});
+            }
+    mesh.depositSubgrid<1>(sg, far.low[0], far.low[1], far.low[2], {2.0});
+    mesh.reshapeSubgrids(sg);
+
+    EXPECT_EQ(target[0], 3.0);
+    EXPECT_EQ(std::accumulate(target.begin(), target.end(), 0.0), target.size() + 2.0);
+}
+
+TEST(meshTest, testExchangeValuesSplitsLargeMessages)
+{
+    int rank = 0, numRanks = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numRanks);
+
+    // ring of 10 values per rank with 64-bit counts, sent in messages of at most 3 values
+    int                   right = (rank + 1) % numRanks;
+    int                   left  = (rank + numRanks - 1) % numRanks;
+    std::vector<uint64_t> sendCount(numRanks, 0), recvCount(numRanks, 0);
+    std::vector<uint64_t> sendDisp(numRanks + 1, 0), recvDisp(numRanks + 1, 0);
+    sendCount[right] = 10;
+    recvCount[left]  = 10;
+    std::partial_sum(sendCount.begin(), sendCount.end(), sendDisp.begin() + 1);
+    std::partial_sum(recvCount.begin(), recvCount.end(), recvDisp.begin() + 1);
+
+    std::vector<double> send(10), recv(10, -1.0), expected(10);
+    std::iota(send.begin(), send.end(), 100.0 * rank);
+    std::iota(expected.begin(), expected.end(), 100.0 * left);
+    for (bool sparse : {false, true})
+    {
+        exchangeValues(send.data(), sendCount, sendDisp, recv.data(), recvCount, recvDisp, sparse, MPI_COMM_WORLD, 3);
+        EXPECT_EQ(recv, expected);
+    }
+}
+
+TEST(meshTest, testChunkedExchangeMatchesSingleRound)
+{
+    int rank = 0, numRanks = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numRanks);
+
+    int gridSize  = 4;
+    int numShells = gridSize / 2;
+
+    // two particles per cell and rank with rank-dependent offsets and velocities
+    std::vector<KeyType> keys;
+    std::vector<double>  x, y, z, vx, vy, vz;
+    for (int i = 0; i < gridSize; i++)
+        for (int j = 0; j < gridSize; j++)
+            for (int k = 0; k < gridSize; k++)
+                for (int p = 0; p < 2; p++)
+                {
+                    double offset = 0.005 * (rank + 1) * (p + 1);
+                    keys.push_back(cstone::iHilbert<KeyType>(i * 524289, j * 524289, k * 524289));
+                    x.push_back(-0.5 + (i + 0.5) / gridSize + offset);
+                    y.push_back(-0.5 + (j + 0.5) / gridSize - offset);
+                    z.push_back(-0.5 + (k + 0.5) / gridSize + offset);
+                    vx.push_back(i + 10.0 * rank + p);
+                    vy.push_back(j - 10.0 * rank);
+                    vz.push_back(k * (rank + 1));
+                }
+
+    Mesh<double> single(rank, numRanks, gridSize, numShells);
+    Mesh<double> chunked(rank, numRanks, gridSize, numShells);
+    // a few records per round, forces many rounds with partial grants
+    chunked.exchangeBudgetBytes_ = 100;
+
+    single.rasterize_particles_to_mesh(keys, x, y, z, vx, vy, vz, 2);
+    chunked.rasterize_particles_to_mesh(keys, x, y, z, vx, vy, vz, 2);
+    EXPECT_EQ(single.velX_, chunked.velX_);
+    EXPECT_EQ(single.velZ_, chunked.velZ_);
+
+    single.rasterize_particles_to_mesh_cell_avg(keys, x, y, z, vx, vy, vz, 2);
+    chunked.rasterize_particles_to_mesh_cell_avg(keys, x, y, z, vx, vy, vz, 2);
+    EXPECT_EQ(single.cellCount_, chunked.cellCount_);
+    for (size_t i = 0; i < single.velY_.size(); i++)
+    {
+        EXPECT_NEAR(single.velY_[i], chunked.velY_[i], 1e-12);
+    }
+
+    single.rasterize_particles_to_density(keys, x, y, z, 2);
+    chunked.rasterize_particles_to_density(keys, x, y, z, 2);
+    for (size_t i = 0; i < single.massSum_.size(); i++)
+    {
+        EXPECT_NEAR(single.massSum_[i], chunked.massSum_[i], 1e-12);
+    }
+}
+
+TEST(meshTest, testBlockAccumulationMatchesSingleCall)
+{
+    int rank = 0, numRanks = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numRanks);
+
+    int gridSize  = 4;
+    int numShells = gridSize / 2;
+
+    std::vector<KeyType> keys;
+    std::vector<double>  x, y, z, vx, vy, vz;
+    for (int i = 0; i < gridSize; i++)
+        for (int j = 0; j < gridSize; j++)
+            for (int k = 0; k < gridSize; k++)
+                for (int p = 0; p < 2; p++)
+                {
+                    double offset = 0.005 * (rank + 1) * (p + 1);
+                    keys.push_back(cstone::iHilbert<KeyType>(i * 524289, j * 524289, k * 524289));
+                    x.push_back(-0.5 + (i + 0.5) / gridSize + offset);
+                    y.push_back(-0.5 + (j + 0.5) / gridSize - offset);
+                    z.push_back(-0.5 + (k + 0.5) / gridSize + offset);
+                    vx.push_back(i + 10.0 * rank + p);
+                    vy.push_back(j - 10.0 * rank);
+                    vz.push_back(k * (rank + 1));
+                }
+
+    // three blocks per rank, rank 0 puts all particles into the first one and passes empty blocks afterwards
+    size_t              n      = keys.size();
+    std::vector<size_t> bounds = {0, n / 3, n / 2, n};
+    if (rank == 0) { bounds = {0, n, n, n}; }
+    auto slice = [&](const auto& v, int b)
+    { return std::decay_t<decltype(v)>(v.begin() + bounds[b], v.begin() + bounds[b + 1]); };
+
+    Mesh<double> single(rank, numRanks, gridSize, numShells);
+    Mesh<double> blocked(rank, numRanks, gridSize, numShells);
+
+    single.rasterize_particles_to_mesh_cell_avg(keys, x, y, z, vx, vy, vz, 2);
+    blocked.beginBlocks();
+    for (int b = 0; b < 3; b++)
+    {
+        blocked.rasterize_particles_to_mesh_cell_avg(slice(keys, b), slice(x, b), slice(y, b), slice(z, b),
+                                                     slice(vx, b), slice(vy, b), slice(vz, b), 2);
+    }
+    blocked.endBlocks();
+    blocked.finalizeCellAverages();
+    blocked.extrapolateEmptyCellsFromNeighbors();
+    EXPECT_EQ(single.cellCount_, blocked.cellCount_);
+    for (size_t i = 0; i < single.velX_.size(); i++)
+    {
+        EXPECT_NEAR(single.velX_[i], blocked.velX_[i], 1e-12);
+        EXPECT_NEAR(single.velZ_[i], blocked.velZ_[i], 1e-12);
+    }
+
+    single.rasterize_particles_to_density(keys, x, y, z, 2);
+    blocked.beginBlocks();
+    for (int b = 0; b < 3; b++)
+    {
+        blocked.rasterize_particles_to_density(slice(keys, b), slice(x, b), slice(y, b), slice(z, b), 2);
+    }
+    blocked.endBlocks();
+    blocked.finalizeDensityFromMass();
+    for (size_t i = 0; i < single.density_.size(); i++)
+    {
+        EXPECT_NEAR(single.density_[i], blocked.density_[i], 1e-12);
+    }
+}
+
+TEST(meshTest, testFloatParticlesMatchDouble)
+{
+    int rank = 0, numRanks = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numRanks);
+
+    int gridSize  = 4;
+    int numShells = gridSize / 2;
+
+    // coordinates and velocities exactly representable in float
+    std::vector<KeyType> keys;
+    std::vector<double>  x, y, z, h, vx, vy, vz;
+    for (int i = 0; i < gridSize; i++)
+        for (int j = 0; j < gridSize; j++)
+            for (int k = 0; k < gridSize; k++)
+            {
+                double offset = (rank + 1) / 256.0;
+                keys.push_back(cstone::iHilbert<KeyType>(i * 524289, j * 524289, k * 524289));
+                x.push_back(-0.5 + (i + 0.5) / gridSize + offset);
+                y.push_back(-0.5 + (j + 0.5) / gridSize - offset);
+                z.push_back(-0.5 + (k + 0.5) / gridSize + offset);
+                h.push_back(0.25);
+                vx.push_back(i + 8.0 * rank);
+                vy.push_back(j - 0.5 * rank);
+                vz.push_back(k * (rank + 1));
+            }
+
+    auto toFloat = [](const std::vector<double>& v) { return std::vector<float>(v.begin(), v.end()); };
+
+    Mesh<double> fromDouble(rank, numRanks, gridSize, numShells);
+    Mesh<double> fromFloat(rank, numRanks, gridSize, numShells);
+
+    fromDouble.rasterize_particles_to_mesh_cell_avg(keys, x, y, z, vx, vy, vz, 2);
+    fromFloat.rasterize_particles_to_mesh_cell_avg(keys, toFloat(x), toFloat(y), toFloat(z), toFloat(vx), toFloat(vy),
+                                                   toFloat(vz), 2);
+    EXPECT_EQ(fromDouble.velX_, fromFloat.velX_);
+    EXPECT_EQ(fromDouble.velY_, fromFloat.velY_);
+
+    fromDouble.rasterize_particles_to_mesh_sph(keys, x, y, z, vx, vy, vz, h, 2);
+    fromFloat.rasterize_particles_to_mesh_sph(keys, toFloat(x), toFloat(y), toFloat(z), toFloat(vx), toFloat(vy),
+                                              toFloat(vz), toFloat(h), 2);
+    for (size_t i = 0; i < fromDouble.velZ_.size(); i++)
+    {
+        EXPECT_NEAR(fromDouble.velZ_[i], fromFloat.velZ_[i], 1e-12);
+    }
+}
+
+TEST(meshTest, testShellStatisticsFollowMergedBins)
+{
+    int rank = 0, numRanks = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numRanks);
+
+    Mesh<double> mesh(rank, numRanks, 8, 4);
+
+    // shell 0 has too few modes and is merged into shell 1, the others stand alone
+    std::vector<int>    counts{10, 60, 100, 200};
+    std::vector<double> k_1d{0, 1, 2, 3, 4, 3, 2, 1};
+    std::vector<double> kSums{5.0, 66.0, 210.0, 620.0};
+    mesh.power_spectrum_ = {1.0, 5.0, 4.0, 8.0};
+    mesh.normalizeShells(counts, k_1d, {}, kSums);
+
+    if (rank == 0)
+    {
+        EXPECT_EQ(mesh.shellCounts_, counts);
+        EXPECT_EQ(mesh.shellPower_, (std::vector<double>{1.0, 5.0, 4.0, 8.0}));
+        EXPECT_EQ(mesh.shellMinCount_, 64);
+
+        // the mean |k| follows the sums of |k|, the normalization keeps the k^2 of the shell centers
+        double k2Merged = 60.0 / 70.0;
+        EXPECT_NEAR(mesh.shellK_[0], 71.0 / 70.0, 1e-14);
+        EXPECT_NEAR(mesh.shellK_[1], 71.0 / 70.0, 1e-14);
+        EXPECT_NEAR(mesh.shellK_[3], 3.1, 1e-14);
+        EXPECT_NEAR(mesh.power_spectrum_[1], 6.0 / 70.0 * 4.0 * M_PI * k2Merged, 1e-12);
+        EXPECT_NEAR(mesh.power_spectrum_[2], 4.0 / 100.0 * 4.0 * M_PI * 4.0, 1e-12);
+    }
+}
+
+TEST(meshTest, testRestrictionAveragesFineCells)
+{
+    int rank = 0, numRanks = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numRanks);
+
+    int          fineSize = 8;
+    Mesh<double> fine(rank, numRanks, fineSize, fineSize / 2);
+    Mesh<double> coarse(rank, numRanks, fineSize / 2, fineSize / 4);
+
+    // fine cell (i, j, k) holds i + 10 j + 100 k, the average over a 2x2x2 block is the value at its center
+    const auto& box = fine.inbox_;
+    for (int k = box.low[2]; k <= box.high[2]; k++)
+        for (int j = box.low[1]; j <= box.high[1]; j++)
+            for (int i = box.low[0]; i <= box.high[0]; i++)
+            {
+                uint64_t idx = (i - box.low[0]) + (j - box.low[1]) * box.size[0] +
+                               uint64_t(k - box.low[2]) * box.size[0] * box.size[1];
+                fine.velX_[idx] = i + 10.0 * j + 100.0 * k;
+                fine.velY_[idx] = 1.0;
+                fine.velZ_[idx] = -double(k);
+            }
+
+    coarse.restrictFrom(fine);
+
+    const auto& cbox = coarse.inbox_;
+    for (int k = cbox.low[2]; k <= cbox.high[2]; k++)
+        for (int j = cbox.low[1]; j <= cbox.high[1]; j++)
+            for (int i = cbox.low[0]; i <= cbox.high[0]; i++)
+            {
+                uint64_t idx = (i - cbox.low[0]) + (j - cbox.low[1]) * cbox.size[0] +
+                               uint64_t(k - cbox.low[2]) * cbox.size[0] * cbox.size[1];
+                EXPECT_NEAR(coarse.velX_[idx], (2 * i + 0.5) + 10.0 * (2 * j + 0.5) + 100.0 * (2 * k + 0.5), 1e-12);
+                EXPECT_NEAR(coarse.velY_[idx], 1.0, 1e-12);
+                EXPECT_NEAR(coarse.velZ_[idx], -(2 * k + 0.5), 1e-12);
+            }
+}
+
+TEST(meshTest, testCompressivePowerProjectsOntoK)
+{
+    int rank = 0, numRanks = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numRanks);
+
+    int          gridSize = 8;
+    Mesh<double> mesh(rank, numRanks, gridSize, gridSize / 2);
+
+    std::vector<double> k_values(gridSize);
+    mesh.fftfreq(k_values, gridSize, 1.0 / gridSize);
+
+    // a mode parallel to k is fully compressive, one orthogonal to k carries no compressive power
+    const auto&                       box = mesh.inbox_;
+    std::vector<std::complex<double>> ax(box.count()), ay(box.count()), az(box.count());
+    std::vector<std::complex<double>> tx(box.count()), ty(box.count()), tz(box.count());
+    std::vector<double>               k2(box.count());
+    for (int k = box.low[2]; k <= box.high[2]; k++)
+        for (int j = box.low[1]; j <= box.high[1]; j++)
+            for (int i = box.low[0]; i <= box.high[0]; i++)
+            {
+                uint64_t idx = (i - box.low[0]) + (j - box.low[1]) * box.size[0] +
+                               uint64_t(k - box.low[2]) * box.size[0] * box.size[1];
+                double kx = k_values[i], ky = k_values[j], kz = k_values[k];
+                ax[idx]   = {kx, 2 * kx};
+                ay[idx]   = {ky, 2 * ky};
+                az[idx]   = {kz, 2 * kz};
+                tx[idx]   = {ky, 0};
+                ty[idx]   = {-kx, 0};
+                tz[idx]   = {0, 0};
+                k2[idx]   = kx * kx + ky * ky + kz * kz;
+            }
+
+    mesh.compressivePower(ax, ay, az, 1);
+    for (size_t i = 0; i < k2.size(); i++)
+    {
+        EXPECT_NEAR(mesh.compressive_[i], 5 * k2[i], 1e-9);
+    }
+
+    mesh.compressivePower(tx, ty, tz, 1);
+    for (size_t i = 0; i < k2.size(); i++)
+    {
+        EXPECT_NEAR(mesh.compressive_[i], 0.0, 1e-9);
+    }
+}
+
+TEST(meshTest, testScalarSpectrumMatchesZeroFilledComponents)
+{
+    int rank = 0, numRanks = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numRanks);
+
+    int          gridSize = 8;
+    Mesh<double> vector(rank, numRanks, gridSize, gridSize / 2);
+    Mesh<double> scalar(rank, numRanks, gridSize, gridSize / 2);
+    scalar.releaseVectorComponents();
+    EXPECT_TRUE(scalar.velY_.empty() && scalar.velZ_.empty());
+
+    const auto& box = vector.inbox_;
+    for (int k = box.low[2]; k <= box.high[2]; k++)
+        for (int j = box.low[1]; j <= box.high[1]; j++)
+            for (int i = box.low[0]; i <= box.high[0]; i++)
+            {
+                uint64_t idx = (i - box.low[0]) + (j - box.low[1]) * box.size[0] +
+                               uint64_t(k - box.low[2]) * box.size[0] * box.size[1];
+                double value       = std::sin(2 * M_PI * i / gridSize) + 0.5 * std::cos(4 * M_PI * k / gridSize);
+                vector.velX_[idx]  = value;
+                scalar.velX_[idx]  = value;
+            }
+    std::fill(vector.velY_.begin(), vector.velY_.end(), 0.0);
+    std::fill(vector.velZ_.begin(), vector.velZ_.end(), 0.0);
+
+    vector.calculate_power_spectrum();
+    scalar.calculate_power_spectrum();
+
+    if (rank == 0)
+    {
+        for (int i = 0; i < vector.numShells_; i++)
+        {
+            EXPECT_NEAR(scalar.power_spectrum_[i], vector.power_spectrum_[i], 1e-12);
+        }
+    }
+}
+
+TEST(meshTest, testCylindricalBinsSplitParallelAndPerpendicular)
+{
+    int rank = 0, numRanks = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numRanks);
+
+    int          gridSize = 8;
+    Mesh<double> mesh(rank, numRanks, gridSize, gridSize / 2);
+
+    std::vector<double> k_values(gridSize);
+    mesh.fftfreq(k_values, gridSize, 1.0 / gridSize);
+
+    // unit power in the two modes k = (0, 0, +-2)
+    const auto&         box = mesh.inbox_;
+    std::vector<double> ps(box.count(), 0.0);
+    for (int k = box.low[2]; k <= box.high[2]; k++)
+        for (int j = box.low[1]; j <= box.high[1]; j++)
+            for (int i = box.low[0]; i <= box.high[0]; i++)
+            {
+                uint64_t idx = (i - box.low[0]) + (j - box.low[1]) * box.size[0] +
+                               uint64_t(k - box.low[2]) * box.size[0] * box.size[1];
+                if (k_values[i] == 0 && k_values[j] == 0 && std::abs(k_values[k]) == 2) { ps[idx] = 1.0; }
+            }
+
+    int numShells = mesh.numShells_;
+    for (int axis : {2, 0})
+    {
+        mesh.cylinderAxis_ = axis;
+        mesh.perform_spherical_averaging(ps.data());
+        if (rank != 0) { continue; }
+
+        ASSERT_EQ(mesh.cylinderPower_.size(), size_t(gridSize / 2 + 1) * numShells);
+        EXPECT_EQ(std::accumulate(mesh.cylinderCounts_.begin(), mesh.cylinderCounts_.end(), 0),
+                  gridSize * gridSize * gridSize);
+        EXPECT_EQ(mesh.cylinderCounts_[0], 1);
+        // k_perp = 1 and sqrt(2) both round to shell 1, the bin reports their mean
+        EXPECT_EQ(mesh.cylinderCounts_[1], 8);
+        EXPECT_NEAR(mesh.cylinderKPerp_[1], (1.0 + std::sqrt(2.0)) / 2, 1e-12);
+
+        // along the axis both modes have k_par = 2, about another axis they have k_perp = 2
+        int bin = axis == 2 ? 2 * numShells : 2;
+        EXPECT_DOUBLE_EQ(mesh.cylinderPower_[bin], 2.0);
+        EXPECT_DOUBLE_EQ(std::accumulate(mesh.cylinderPower_.begin(), mesh.cylinderPower_.end(), 0.0), 2.0);
+    }
+}
+
+TEST(meshTest, testCustomShellEdgesBinModes)
+{
+    int rank = 0, numRanks = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numRanks);
+
+    int          gridSize = 8;
+    Mesh<double> mesh(rank, numRanks, gridSize, gridSize / 2);
+    mesh.setShellEdges({0.5, 1.5, 2.5});
+    EXPECT_EQ(mesh.numShells_, 2);
+    EXPECT_EQ(mesh.shellIndex(0.4), -1);
+    EXPECT_EQ(mesh.shellIndex(1.5), 1);
+    EXPECT_EQ(mesh.shellIndex(2.5), 1);
+    EXPECT_EQ(mesh.shellIndex(2.6), -1);
+    EXPECT_THROW(mesh.setShellEdges({1.0, 1.0}), std::invalid_argument);
+
+    auto logEdges = Mesh<double>::logShellEdges(1.0, 8.0, 3);
+    EXPECT_NEAR(logEdges[1], 2.0, 1e-14);
+    EXPECT_NEAR(logEdges[3], 8.0, 1e-14);
+
+    // unit power per mode, shell 0 holds |k| = 1, sqrt(2) and shell 1 |k| = sqrt(3), 2, sqrt(5), sqrt(6)
+    std::vector<double> ps(mesh.inbox_.count(), 1.0);
+    setenv("PS_MIN_BIN_COUNT", "1", 1);
+    mesh.perform_spherical_averaging(ps.data());
+    unsetenv("PS_MIN_BIN_COUNT");
+
+    if (rank == 0)
+    {
+        EXPECT_EQ(mesh.shellCounts_, (std::vector<int>{18, 62}));
+        double kMean0  = (6 * 1.0 + 12 * std::sqrt(2.0)) / 18;
+        double kMean1  = (8 * std::sqrt(3.0) + 6 * 2.0 + 24 * std::sqrt(5.0) + 24 * std::sqrt(6.0)) / 62;
+        double k2Mean1 = (8 * 3.0 + 6 * 4.0 + 24 * 5.0 + 24 * 6.0) / 62;
+        EXPECT_NEAR(mesh.shellK_[0], kMean0, 1e-12);
+        EXPECT_NEAR(mesh.shellK_[1], kMean1, 1e-12);
+        EXPECT_NEAR(mesh.power_spectrum_[1], 4.0 * M_PI * k2Mean1, 1e-10);
+    }
+}
+
+TEST(meshTest, testStepsOfDifferentSizesMatchSingleSteps)
+{
+    int rank = 0, numRanks = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numRanks);
+
+    // this rank's file-order share of an n^3 lattice step, as read from a checkpoint
+    auto spectrumOf = [&](Mesh<double>& mesh, int n, double amplitude)
+    {
+        uint64_t            numGlobal = uint64_t(n) * n * n;
+        uint64_t            first = numGlobal * rank / numRanks, last = numGlobal * (rank + 1) / numRanks;
+        std::vector<double> x, y, z, h, vx, vy, vz;
+        for (uint64_t i = first; i < last; i++)
+        {
+            x.push_back(-0.5 + (i % n + 0.3) / n);
+            y.push_back(-0.5 + ((i / n) % n + 0.6) / n);
+            z.push_back(-0.5 + (i / (n * n) + 0.5) / n);
+            h.push_back(1.2 / n);
+            vx.push_back(amplitude * std::sin(2 * M_PI * x.back()));
+            vy.push_back(std::cos(4 * M_PI * y.back()));
+            vz.push_back(x.back() * z.back());
+        }
+
+        std::vector<KeyType> keys;
+        uint64_t             numAssigned = syncStep(rank, numRanks, numGlobal, keys, x, y, z, h, std::tie(vx, vy, vz));
+        MPI_Allreduce(MPI_IN_PLACE, &numAssigned, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+        EXPECT_EQ(numAssigned, numGlobal);
+        mesh.resetRasterFields();
+        mesh.rasterize_particles_to_mesh(keys, x, y, z, vx, vy, vz, int(std::ceil(std::log2(n))));
+        mesh.calculate_power_spectrum();
+        return mesh.power_spectrum_;
+    };
+
+    // one mesh through steps of 8^3 and 10^3 particles, against fresh meshes per step
+    int          gridSize = 8;
+    Mesh<double> multiStep(rank, numRanks, gridSize, gridSize / 2);
+    auto         first  = spectrumOf(multiStep, 8, 1.0);
+    auto         second = spectrumOf(multiStep, 10, 2.0);
+
+    Mesh<double> single1(rank, numRanks, gridSize, gridSize / 2);
+    Mesh<double> single2(rank, numRanks, gridSize, gridSize / 2);
+    auto         expected1 = spectrumOf(single1, 8, 1.0);
+    auto         expected2 = spectrumOf(single2, 10, 2.0);
+
+    if (rank == 0)
+    {
+        for (size_t i = 0; i < first.size(); i++)
+        {
+            EXPECT_NEAR(first[i], expected1[i], 1e-12 * std::abs(expected1[i]));
+            EXPECT_NEAR(second[i], expected2[i], 1e-12 * std::abs(expected2[i]));
+        }
+    }
+}
+
+TEST(meshTest, testExplicitProcGridSplitsMesh)
+{
+    int rank = 0, numRanks = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &numRanks);
+
+    // a tuned grid is taken as is, one with the wrong rank count falls back to the min-surface grid
+    int          gridSize = 8;
+    Mesh<double> mesh(rank, numRanks, gridSize, gridSize / 2, {1, 1, numRanks});
+    EXPECT_EQ(mesh.proc_grid_, (std::array<int, 3>{1, 1, numRanks}));
+    EXPECT_EQ(mesh.inbox_.size[0], gridSize);
+    EXPECT_EQ(mesh.inbox_.size[1], gridSize);
+
+    long long count = mesh.inbox_.count();
+    MPI_Allreduce(MPI_IN_PLACE, &count, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    EXPECT_EQ(count, gridSize * gridSize * gridSize);
+
+    Mesh<double> fallback(rank, numRanks, gridSize, gridSize / 2, {numRanks + 1, 1, 1});
+    heffte::box3d<> allIndexes({0, 0, 0}, {gridSize - 1, gridSize - 1, gridSize - 1});
+    EXPECT_EQ(fallback.proc_grid_, heffte::proc_setup_min_surface(allIndexes, numRanks));
+}